@@ -0,0 +1,32 @@
+#ifndef FUZZ_H
+#define FUZZ_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#define FUZZ_MAP_SIZE   65536
+#define FUZZ_KEY_PERIOD 64      /* cycles between key state changes */
+
+/*
+ * default cycle budget per input, four key periods. the standalone
+ * driver runs games/demo.c8 at about 150-230k exec/s with it, against
+ * about 55k at 2000 cycles, for some 5% fewer edges. -c raises it for
+ * roms that need longer runs to get anywhere
+ * */
+#define FUZZ_CYCLES     256
+
+/* hit counters for (previous pc, pc) edges of the last input */
+extern uint8_t fuzz_coverage[FUZZ_MAP_SIZE];
+
+/*
+ * the entries of fuzz_coverage the last input hit, the rest of the map
+ * is zero. only these are cleared before the next input
+ * */
+extern uint16_t fuzz_edges[FUZZ_MAP_SIZE];
+extern uint32_t fuzz_num_edges;
+
+extern uint32_t fuzz_cycles;
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+#endif
@@ -0,0 +1,60 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fuzz.h"
+#include "../src/chip8.h"
+
+/*
+ * under libFuzzer the map is placed in the extra counters section so the
+ * edges between emulated instructions drive the search next to the
+ * native coverage of the interpreter itself
+ * */
+#if defined(__clang__) && defined(__linux__)
+__attribute__((section("__libfuzzer_extra_counters")))
+#endif
+uint8_t fuzz_coverage[FUZZ_MAP_SIZE];
+
+uint16_t fuzz_edges[FUZZ_MAP_SIZE];
+uint32_t fuzz_num_edges;
+uint32_t fuzz_cycles = FUZZ_CYCLES;
+
+static chip8* c;
+
+/*
+ * runs the input as a rom for a bounded number of cycles, the instance
+ * is reused between inputs and nothing is printed
+ * */
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    if (c == NULL)
+        c = chip8_init();
+    chip8_reset(c);
+    if (chip8_program_load_mem(c, data, size) != 0)
+        return 0;
+
+    /* the key states must replay the same for the same input,
+     * Cxkk already does since chip8_reset reseeds c->rng */
+    srand(0);
+    for (uint32_t i=0; i<fuzz_num_edges; i++)
+        fuzz_coverage[fuzz_edges[i]] = 0;
+    fuzz_num_edges = 0;
+
+    uint16_t prev = c->pc;
+    for (uint32_t i=0; i<fuzz_cycles && !chip8_check_flag(c, HALT); i++) {
+        if (i % FUZZ_KEY_PERIOD == 0) {
+            int keys = rand();
+            for (uint8_t k=0; k<NUM_KEYS; k++)
+                chip8_key_set(c, k, (keys >> k) & 1);
+        }
+
+        chip8_emulate_cycle(c);
+
+        uint16_t edge = (prev << 4 ^ c->pc) & (FUZZ_MAP_SIZE - 1);
+        uint8_t* hit = &fuzz_coverage[edge];
+        if (*hit == 0)
+            fuzz_edges[fuzz_num_edges++] = edge;
+        if (*hit != 0xFF)
+            (*hit)++;
+        prev = c->pc;
+    }
+    return 0;
+}
@@ -0,0 +1,200 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "fuzz.h"
+#include "../src/chip8.h"
+
+#define MAX_INPUT  (MEM_SIZE - PROGRAM_START)
+#define MAX_CORPUS 4096
+
+/*
+ * standalone mutation driver for compilers without libFuzzer. inputs that
+ * reach a new edge, or an edge in a new hit count bucket, join the corpus
+ * */
+
+struct input_t {
+    uint8_t* data;
+    size_t   size;
+};
+typedef struct input_t input;
+
+static input    corpus[MAX_CORPUS];
+static uint32_t corpus_size;
+static uint8_t  seen[FUZZ_MAP_SIZE];    /* buckets reached so far per edge */
+static const char* out_dir;
+
+/* classifies hit counts like AFL: 1, 2, 3, 4-7, 8-15, 16-31, 32-127, 128+ */
+static uint8_t bucket(uint8_t n) {
+    if (n == 0)   return 0;
+    if (n <= 3)   return 1 << (n - 1);
+    if (n <= 7)   return 1 << 3;
+    if (n <= 15)  return 1 << 4;
+    if (n <= 31)  return 1 << 5;
+    if (n <= 127) return 1 << 6;
+    return 1 << 7;
+}
+
+/* only the edges the input hit can add anything */
+static uint32_t coverage_merge() {
+    uint32_t found = 0;
+    for (uint32_t j=0; j<fuzz_num_edges; j++) {
+        uint16_t i = fuzz_edges[j];
+        uint8_t b = bucket(fuzz_coverage[i]);
+        if (b & ~seen[i]) {
+            seen[i] |= b;
+            found++;
+        }
+    }
+    return found;
+}
+
+static void corpus_add(const uint8_t* data, size_t size) {
+    if (corpus_size == MAX_CORPUS)
+        return;
+    input* in = &corpus[corpus_size++];
+    in->data = malloc(size ? size : 1);
+    in->size = size;
+    memcpy(in->data, data, size);
+
+    if (out_dir != NULL) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%016llx.c8", out_dir,
+                 (unsigned long long)chip8_rom_hash(data, size));
+        FILE* f = fopen(path, "wb");
+        if (f != NULL) {
+            fwrite(data, 1, size, f);
+            fclose(f);
+        }
+    }
+}
+
+static size_t file_read(const char* filename, uint8_t* buf) {
+    FILE* f = fopen(filename, "rb");
+    if (f == NULL) {
+        fprintf(stderr, "could not open \"%s\"\n", filename);
+        return 0;
+    }
+    size_t size = fread(buf, 1, MAX_INPUT, f);
+    fclose(f);
+    return size;
+}
+
+/*
+ * applies a few random edits to buf, mostly at instruction granularity
+ * since most bytes of a rom are opcodes
+ * */
+static size_t mutate(uint8_t* buf, size_t size) {
+    uint8_t edits = 1 + rand() % 4;
+    while (edits-- > 0) {
+        size_t pos = size ? rand() % size : 0;
+        switch (rand() % 6) {
+            case 0: /* flip a bit */
+                if (size) buf[pos] ^= 1 << (rand() % 8);
+                break;
+            case 1: /* random byte */
+                if (size) buf[pos] = rand();
+                break;
+            case 2: /* random opcode */
+                pos &= ~1;
+                if (pos + 1 < size) {
+                    buf[pos] = rand();
+                    buf[pos + 1] = rand();
+                }
+                break;
+            case 3: /* insert an opcode */
+                if (size + 2 <= MAX_INPUT) {
+                    pos &= ~1;
+                    memmove(buf + pos + 2, buf + pos, size - pos);
+                    buf[pos] = rand();
+                    buf[pos + 1] = rand();
+                    size += 2;
+                }
+                break;
+            case 4: /* delete an opcode */
+                if (size >= 2) {
+                    pos &= ~1;
+                    if (pos + 2 > size) pos = size - 2;
+                    memmove(buf + pos, buf + pos + 2, size - pos - 2);
+                    size -= 2;
+                }
+                break;
+            case 5: /* splice in part of another input */
+                if (corpus_size > 0) {
+                    input* other = &corpus[rand() % corpus_size];
+                    if (other->size == 0) break;
+                    size_t from = rand() % other->size;
+                    size_t len = 1 + rand() % (other->size - from);
+                    if (pos + len > MAX_INPUT) len = MAX_INPUT - pos;
+                    memcpy(buf + pos, other->data + from, len);
+                    if (pos + len > size) size = pos + len;
+                }
+                break;
+        }
+    }
+    return size;
+}
+
+int main(int argc, char** argv) {
+    uint32_t runs = 100000;
+    unsigned seed = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "c:n:o:s:")) != -1) {
+        switch (opt) {
+            case 'c': fuzz_cycles = strtoul(optarg, NULL, 0); break;
+            case 'n': runs = strtoul(optarg, NULL, 0); break;
+            case 'o': out_dir = optarg; break;
+            case 's': seed = strtoul(optarg, NULL, 0); break;
+            default:
+                fprintf(stderr, "usage: %s [-n runs] [-c cycles] [-o corpus_dir] [-s seed] [seed.c8 ...]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    uint8_t buf[MAX_INPUT];
+    uint32_t features = 0;
+
+    for (int i=optind; i<argc; i++) {
+        size_t size = file_read(argv[i], buf);
+        LLVMFuzzerTestOneInput(buf, size);
+        features += coverage_merge();
+        corpus_add(buf, size);
+    }
+    if (corpus_size == 0) {
+        buf[0] = 0x00;
+        buf[1] = 0xE0;
+        corpus_add(buf, 2);
+    }
+
+    /* the harness reseeds rand() for every input */
+    uint32_t state = seed;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t n=0; n<runs; n++) {
+        srand(state);
+        state = rand();
+
+        input* parent = &corpus[state % corpus_size];
+        memcpy(buf, parent->data, parent->size);
+        size_t size = mutate(buf, parent->size);
+
+        LLVMFuzzerTestOneInput(buf, size);
+        uint32_t found = coverage_merge();
+        if (found > 0) {
+            features += found;
+            corpus_add(buf, size);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("%u runs, %u inputs, %u features, %.0f exec/s\n",
+           runs, corpus_size, features, secs > 0 ? runs / secs : 0.0);
+
+    for (uint32_t i=0; i<corpus_size; i++)
+        free(corpus[i].data);
+    return 0;
+}
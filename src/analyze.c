@@ -0,0 +1,299 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "analyze.h"
+
+#define ANALYSIS_MAGIC 0x46433843 /* "C8CF" */
+
+#define BIT_GET(map, a) (((map)[(a) >> 3] >> ((a) & 7)) & 1)
+#define BIT_SET(map, a) ((map)[(a) >> 3] |= 1 << ((a) & 7))
+
+/* how an instruction affects control flow */
+enum {
+    FLOW_NEXT,      /* continues with the next instruction */
+    FLOW_JUMP,      /* 1nnn */
+    FLOW_CALL,      /* 2nnn */
+    FLOW_RETURN,    /* 00EE */
+    FLOW_SKIP,      /* conditional skip of the next instruction */
+    FLOW_INDIRECT,  /* Bnnn */
+    FLOW_HALT       /* invalid opcode, chip8_error halts */
+};
+
+/*
+ * classifies an opcode the same way the handlers in func_table treat it
+ * */
+static uint8_t flow_of(uint16_t op) {
+    uint8_t kk = op & 0xFF;
+    uint8_t n = op & 0xF;
+    switch (op >> 12) {
+        case 0x0:
+            if (op == 0x0000 || op == 0x00E0) return FLOW_NEXT;
+            if (op == 0x00EE) return FLOW_RETURN;
+            return FLOW_HALT;
+        case 0x1: return FLOW_JUMP;
+        case 0x2: return FLOW_CALL;
+        case 0x3:
+        case 0x4:
+        case 0x5:
+        case 0x9: return FLOW_SKIP;
+        case 0x8: return (n <= 0x7 || n == 0xE) ? FLOW_NEXT : FLOW_HALT;
+        case 0xB: return FLOW_INDIRECT;
+        case 0xE: return (kk == 0x9E || kk == 0xA1) ? FLOW_SKIP : FLOW_HALT;
+        case 0xF:
+            switch (kk) {
+                case 0x07: case 0x0A: case 0x15: case 0x18: case 0x1E:
+                case 0x29: case 0x33: case 0x55: case 0x65:
+                    return FLOW_NEXT;
+            }
+            return FLOW_HALT;
+    }
+    return FLOW_NEXT;
+}
+
+static inline uint16_t fetch(chip8* c, uint16_t addr) {
+    return c->memory[addr & MEM_MASK] << 8 | c->memory[(addr + 1) & MEM_MASK];
+}
+
+static void subroutine_add(analysis* a, uint16_t addr) {
+    for (uint16_t i=0; i<a->num_subroutines; i++)
+        if (a->subroutines[i] == addr)
+            return;
+    if (a->num_subroutines < MAX_SUBROUTINES)
+        a->subroutines[a->num_subroutines++] = addr;
+}
+
+/*
+ * recovers the control flow graph of the loaded rom by decoding from
+ * PROGRAM_START and following every statically known edge, returns
+ * NULL if the result cannot be allocated
+ * */
+analysis* chip8_analyze(chip8* c) {
+    analysis* a = calloc(1, sizeof(analysis));
+    if (a == NULL)
+        return NULL;
+    a->magic = ANALYSIS_MAGIC;
+    a->version = ANALYSIS_VERSION;
+    a->rom_hash = c->rom_hash;
+    a->rom_size = c->rom_size;
+    a->quirks = c->quirks;
+
+    uint8_t  insn[MEM_SIZE / 8] = {0};    /* instruction start addresses */
+    uint8_t  leader[MEM_SIZE / 8] = {0};  /* block start addresses */
+    uint16_t work[MEM_SIZE];
+    uint16_t num_work = 0;
+
+    BIT_SET(leader, PROGRAM_START);
+    work[num_work++] = PROGRAM_START;
+
+    /* first pass: find every reachable instruction and block leader */
+    while (num_work > 0) {
+        uint16_t addr = work[--num_work];
+
+        while (!BIT_GET(insn, addr)) {
+            BIT_SET(insn, addr);
+            BIT_SET(a->code, addr);
+            BIT_SET(a->code, (addr + 1) & MEM_MASK);
+
+            uint16_t op = fetch(c, addr);
+            uint16_t next = (addr + 2) & MEM_MASK;
+            uint16_t target = op & 0x0FFF;
+            uint8_t flow = flow_of(op);
+
+            if ((op & 0xF000) == 0xA000)
+                BIT_SET(a->data_ref, target);
+
+            if (flow == FLOW_NEXT) {
+                addr = next;
+                continue;
+            }
+
+            if (flow == FLOW_JUMP || flow == FLOW_CALL) {
+                if (!BIT_GET(leader, target)) {
+                    BIT_SET(leader, target);
+                    work[num_work++] = target;
+                }
+                if (flow == FLOW_CALL)
+                    subroutine_add(a, target);
+            }
+            if (flow == FLOW_SKIP) {
+                uint16_t skip = (addr + 4) & MEM_MASK;
+                if (!BIT_GET(leader, skip)) {
+                    BIT_SET(leader, skip);
+                    work[num_work++] = skip;
+                }
+            }
+            if (flow == FLOW_INDIRECT && a->num_indirect < MAX_INDIRECT) {
+                a->indirect[a->num_indirect].site = addr;
+                a->indirect[a->num_indirect].base = target;
+                a->num_indirect++;
+            }
+            if (flow == FLOW_CALL || flow == FLOW_SKIP) {
+                if (!BIT_GET(leader, next)) {
+                    BIT_SET(leader, next);
+                    work[num_work++] = next;
+                }
+            }
+            break;
+        }
+    }
+
+    /* second pass: cut the instruction stream into blocks at the leaders */
+    for (uint16_t start=0; start<MEM_SIZE; start++) {
+        if (!BIT_GET(leader, start) || a->num_blocks == MAX_BLOCKS)
+            continue;
+
+        block* b = &a->blocks[a->num_blocks++];
+        b->start = start;
+
+        for (uint16_t addr=start; ; addr=(addr + 2) & MEM_MASK) {
+            uint16_t op = fetch(c, addr);
+            uint16_t next = (addr + 2) & MEM_MASK;
+            uint8_t flow = flow_of(op);
+
+            b->end = addr + 2;
+            switch (flow) {
+                case FLOW_JUMP:
+                    b->succ[b->num_succ++] = op & 0x0FFF;
+                    break;
+                case FLOW_CALL:
+                    b->succ[b->num_succ++] = op & 0x0FFF;
+                    b->succ[b->num_succ++] = next;
+                    b->flags |= BLOCK_CALL;
+                    break;
+                case FLOW_SKIP:
+                    b->succ[b->num_succ++] = next;
+                    b->succ[b->num_succ++] = (addr + 4) & MEM_MASK;
+                    break;
+                case FLOW_RETURN:   b->flags |= BLOCK_RETURN; break;
+                case FLOW_INDIRECT: b->flags |= BLOCK_INDIRECT; break;
+                case FLOW_HALT:     b->flags |= BLOCK_HALT; break;
+                case FLOW_NEXT:
+                    if (!BIT_GET(leader, next))
+                        continue;
+                    b->succ[b->num_succ++] = next;
+                    break;
+            }
+            break;
+        }
+    }
+
+    /* a subroutine owns the blocks reachable from its entry without calls */
+    for (uint16_t i=0; i<a->num_subroutines; i++) {
+        block* b = analysis_block_find(a, a->subroutines[i]);
+        if (b == NULL)
+            continue;
+        b->flags |= BLOCK_SUBROUTINE;
+
+        num_work = 0;
+        work[num_work++] = b->start;
+        while (num_work > 0) {
+            b = analysis_block_find(a, work[--num_work]);
+            if (b == NULL || b->subroutine != 0)
+                continue;
+            b->subroutine = i + 1;
+            for (uint8_t j=(b->flags & BLOCK_CALL) ? 1 : 0; j<b->num_succ; j++)
+                if (num_work < MEM_SIZE)
+                    work[num_work++] = b->succ[j];
+        }
+    }
+
+    return a;
+}
+
+void analysis_free(analysis* a) {
+    free(a);
+}
+
+/*
+ * returns the block starting at addr, blocks are sorted by start address
+ * */
+block* analysis_block_find(analysis* a, uint16_t addr) {
+    uint16_t lo = 0, hi = a->num_blocks;
+    while (lo < hi) {
+        uint16_t mid = (lo + hi) / 2;
+        if (a->blocks[mid].start < addr)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return (lo < a->num_blocks && a->blocks[lo].start == addr) ? &a->blocks[lo] : NULL;
+}
+
+static void analysis_cache_path(char* path, size_t len, const char* dir,
+                                uint64_t rom_hash, uint8_t quirks) {
+    snprintf(path, len, "%s/%016" PRIx64 "-%02x.cfg", dir, rom_hash, quirks);
+}
+
+uint8_t analysis_save(analysis* a, const char* cache_dir) {
+    char path[512];
+    analysis_cache_path(path, sizeof(path), cache_dir, a->rom_hash, a->quirks);
+
+    FILE* f = fopen(path, "wb");
+    if (f == NULL)
+        return 1;
+    size_t written = fwrite(a, sizeof(analysis), 1, f);
+    fclose(f);
+    return written != 1;
+}
+
+/*
+ * a cache file is only trusted once every count in it is in range, a
+ * corrupt or stale one is treated as missing
+ * */
+static uint8_t analysis_valid(analysis* a, uint64_t rom_hash, uint8_t quirks) {
+    if (a->magic != ANALYSIS_MAGIC || a->version != ANALYSIS_VERSION
+        || a->rom_hash != rom_hash || a->quirks != quirks
+        || a->rom_size > MEM_SIZE - PROGRAM_START
+        || a->num_blocks > MAX_BLOCKS
+        || a->num_subroutines > MAX_SUBROUTINES
+        || a->num_indirect > MAX_INDIRECT)
+        return 0;
+    for (uint16_t i=0; i<a->num_blocks; i++) {
+        block* b = &a->blocks[i];
+        if (b->num_succ > 2 || b->subroutine > a->num_subroutines)
+            return 0;
+    }
+    return 1;
+}
+
+analysis* analysis_load(const char* cache_dir, uint64_t rom_hash, uint8_t quirks) {
+    char path[512];
+    analysis_cache_path(path, sizeof(path), cache_dir, rom_hash, quirks);
+
+    FILE* f = fopen(path, "rb");
+    if (f == NULL)
+        return NULL;
+    analysis* a = malloc(sizeof(analysis));
+    if (a == NULL) {
+        fclose(f);
+        return NULL;
+    }
+    size_t read = fread(a, sizeof(analysis), 1, f);
+    fclose(f);
+
+    if (read != 1 || !analysis_valid(a, rom_hash, quirks)) {
+        free(a);
+        return NULL;
+    }
+    return a;
+}
+
+/*
+ * analyses the loaded rom unless a previous result for the same rom
+ * and quirks is found in cache_dir, new results are added to the cache.
+ * a NULL cache_dir always analyses. returns NULL if the result cannot
+ * be allocated
+ * */
+analysis* chip8_analyze_cached(chip8* c, const char* cache_dir) {
+    if (cache_dir == NULL)
+        return chip8_analyze(c);
+    analysis* a = analysis_load(cache_dir, c->rom_hash, c->quirks);
+    if (a != NULL)
+        return a;
+    a = chip8_analyze(c);
+    if (a != NULL)
+        analysis_save(a, cache_dir);
+    return a;
+}
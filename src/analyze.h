@@ -0,0 +1,79 @@
+#ifndef ANALYZE_H
+#define ANALYZE_H
+
+#include <stdint.h>
+#include "chip8.h"
+
+#define MAX_BLOCKS      2048
+#define MAX_SUBROUTINES 256
+#define MAX_INDIRECT    64
+
+#define ANALYSIS_VERSION 1
+
+#define BLOCK_SUBROUTINE 0x01  /* entry of a subroutine */
+#define BLOCK_CALL       0x02  /* ends in CALL */
+#define BLOCK_RETURN     0x04  /* ends in RET */
+#define BLOCK_INDIRECT   0x08  /* ends in JMP V0, see indirect */
+#define BLOCK_HALT       0x10  /* ends in an opcode that halts */
+
+/*
+ * a basic block [start, end), successors are the jump/call target
+ * and the fall-through or skip addresses. subroutine is the index+1
+ * in analysis.subroutines of the subroutine the block belongs to,
+ * or 0 for blocks only reachable from the main program
+ * */
+struct block_t {
+    uint16_t start, end;
+    uint16_t succ[2];
+    uint16_t subroutine;
+    uint8_t  num_succ;
+    uint8_t  flags;
+};
+typedef struct block_t block;
+
+/*
+ * Bnnn can land anywhere in base..base+0xFF, the targets are recorded
+ * but not followed
+ * */
+struct indirect_t {
+    uint16_t site;
+    uint16_t base;
+};
+
+/*
+ * result of a static pass over a rom. this is a flat struct without
+ * pointers so it can be written to and read from the cache as is,
+ * version is bumped whenever its layout or the analysis changes
+ * */
+struct analysis_t {
+    uint32_t magic;
+    uint32_t version;                 /* ANALYSIS_VERSION */
+    uint64_t rom_hash;
+    uint16_t rom_size;
+    uint8_t  quirks;
+
+    uint8_t  code[MEM_SIZE / 8];      /* bytes decoded as instructions */
+    uint8_t  data_ref[MEM_SIZE / 8];  /* addresses loaded into I */
+
+    uint16_t num_blocks;
+    block    blocks[MAX_BLOCKS];
+    uint16_t num_subroutines;
+    uint16_t subroutines[MAX_SUBROUTINES];
+    uint16_t num_indirect;
+    struct indirect_t indirect[MAX_INDIRECT];
+};
+typedef struct analysis_t analysis;
+
+analysis* chip8_analyze(chip8* c);
+analysis* chip8_analyze_cached(chip8* c, const char* cache_dir);
+void      analysis_free(analysis* a);
+uint8_t   analysis_save(analysis* a, const char* cache_dir);
+analysis* analysis_load(const char* cache_dir, uint64_t rom_hash, uint8_t quirks);
+block*    analysis_block_find(analysis* a, uint16_t addr);
+
+static inline uint8_t analysis_is_code(analysis* a, uint16_t addr) {
+    addr &= MEM_MASK;
+    return (a->code[addr >> 3] >> (addr & 7)) & 1;
+}
+
+#endif
@@ -0,0 +1,447 @@
+#include <stdint.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "asm.h"
+
+enum {
+    MN_NONE, MN_SYS, MN_CLS, MN_RET, MN_JMP, MN_CALL, MN_SEQ, MN_SNE, MN_LD,
+    MN_ADD, MN_AND, MN_OR, MN_XOR, MN_SUB, MN_SHR, MN_SUBN, MN_SHL, MN_RND,
+    MN_DRAW, MN_SKP, MN_SKNP, MN_DB, MN_DW
+};
+
+#define KEY2(a,b)     ((uint32_t)(a) << 8 | (b))
+#define KEY3(a,b,c)   (KEY2(a,b) << 8 | (c))
+#define KEY4(a,b,c,d) (KEY3(a,b,c) << 8 | (d))
+
+static const uint32_t mnemonic_keys[] = {
+    [MN_SYS]  = KEY3('S','Y','S'),     [MN_CLS]  = KEY3('C','L','S'),
+    [MN_RET]  = KEY3('R','E','T'),     [MN_JMP]  = KEY3('J','M','P'),
+    [MN_CALL] = KEY4('C','A','L','L'), [MN_SEQ]  = KEY3('S','E','Q'),
+    [MN_SNE]  = KEY3('S','N','E'),     [MN_LD]   = KEY2('L','D'),
+    [MN_ADD]  = KEY3('A','D','D'),     [MN_AND]  = KEY3('A','N','D'),
+    [MN_OR]   = KEY2('O','R'),         [MN_XOR]  = KEY3('X','O','R'),
+    [MN_SUB]  = KEY3('S','U','B'),     [MN_SHR]  = KEY3('S','H','R'),
+    [MN_SUBN] = KEY4('S','U','B','N'), [MN_SHL]  = KEY3('S','H','L'),
+    [MN_RND]  = KEY3('R','N','D'),     [MN_DRAW] = KEY4('D','R','A','W'),
+    [MN_SKP]  = KEY3('S','K','P'),     [MN_SKNP] = KEY4('S','K','N','P'),
+    [MN_DB]   = KEY2('D','B'),         [MN_DW]   = KEY2('D','W'),
+};
+
+/*
+ * perfect hash of the mnemonics packed into 32 bits,
+ * MNEMONIC_MULT was picked so that no two of them share a slot
+ * */
+#define MNEMONIC_MULT 0x2a301u
+#define MNEMONIC_SLOT(key) ((uint32_t)((key) * MNEMONIC_MULT) >> 26)
+
+static const uint8_t mnemonic_slots[64] = {
+    0,       MN_RND,  0,       0,       0,       MN_ADD,  0,       0,
+    MN_SUBN, MN_DRAW, 0,       0,       MN_AND,  0,       0,       0,
+    0,       0,       0,       0,       0,       0,       0,       0,
+    0,       0,       0,       MN_CALL, MN_CLS,  0,       0,       0,
+    0,       0,       0,       0,       MN_SEQ,  MN_SHL,  MN_SHR,  MN_SKP,
+    0,       MN_SNE,  0,       0,       MN_DB,   MN_DW,   MN_SUB,  0,
+    0,       MN_SYS,  MN_LD,   0,       MN_OR,   0,       MN_XOR,  0,
+    MN_SKNP, 0,       MN_JMP,  MN_RET,  0,       0,       0,       0,
+};
+
+/*
+ * operand patterns, one character per operand:
+ *   v register (Vx, then Vy)   0 the register V0
+ *   b byte  n nibble  a address or label
+ *   I D S K F B [  the literal operands I, DT, ST, K, F, B and [I]
+ * */
+static const struct {
+    uint8_t     mnemonic;
+    const char* pattern;
+    uint16_t    opcode;
+} forms[] = {
+    { MN_SYS,  "a",   0x0000 }, { MN_CLS,  "",    0x00E0 },
+    { MN_RET,  "",    0x00EE }, { MN_JMP,  "a",   0x1000 },
+    { MN_JMP,  "0a",  0xB000 }, { MN_CALL, "a",   0x2000 },
+    { MN_SEQ,  "vb",  0x3000 }, { MN_SEQ,  "vv",  0x5000 },
+    { MN_SNE,  "vb",  0x4000 }, { MN_SNE,  "vv",  0x9000 },
+    { MN_LD,   "vb",  0x6000 }, { MN_LD,   "vv",  0x8000 },
+    { MN_LD,   "Ia",  0xA000 }, { MN_LD,   "vD",  0xF007 },
+    { MN_LD,   "Kv",  0xF00A }, { MN_LD,   "Dv",  0xF015 },
+    { MN_LD,   "Sv",  0xF018 }, { MN_LD,   "Fv",  0xF029 },
+    { MN_LD,   "Bv",  0xF033 }, { MN_LD,   "[v",  0xF055 },
+    { MN_LD,   "v[",  0xF065 }, { MN_ADD,  "vb",  0x7000 },
+    { MN_ADD,  "vv",  0x8004 }, { MN_ADD,  "Iv",  0xF01E },
+    { MN_AND,  "vv",  0x8001 }, { MN_OR,   "vv",  0x8002 },
+    { MN_XOR,  "vv",  0x8003 }, { MN_SUB,  "vv",  0x8005 },
+    { MN_SHR,  "vv",  0x8006 }, { MN_SHR,  "v",   0x8006 },
+    { MN_SUBN, "vv",  0x8007 }, { MN_SHL,  "vv",  0x800E },
+    { MN_SHL,  "v",   0x800E }, { MN_RND,  "vb",  0xC000 },
+    { MN_DRAW, "vvn", 0xD000 }, { MN_SKP,  "v",   0xE09E },
+    { MN_SKNP, "v",   0xE0A1 },
+};
+
+enum {
+    OPD_REG, OPD_NUM, OPD_LABEL,
+    OPD_I, OPD_DT, OPD_ST, OPD_K, OPD_F, OPD_B, OPD_IIND
+};
+
+#define MAX_OPERANDS 16
+
+struct operand_t {
+    uint8_t     kind;
+    uint16_t    value;
+    const char* text;
+    uint8_t     len;
+};
+typedef struct operand_t operand;
+
+struct label_t {
+    char     name[ASM_LABEL_LEN];
+    uint16_t addr;
+    uint8_t  used;
+};
+
+struct fixup_t {
+    const char* name;
+    uint8_t     len;
+    uint8_t     word;
+    uint16_t    offset;
+    unsigned    line;
+};
+
+#define LABEL_SLOTS (2 * ASM_MAX_LABELS)
+
+struct assembler_t {
+    uint8_t*       out;
+    size_t         capacity, size;
+    unsigned       line;
+    asm_error*     err;
+    struct label_t labels[LABEL_SLOTS];
+    unsigned       num_labels;
+    struct fixup_t fixups[ASM_MAX_FIXUPS];
+    unsigned       num_fixups;
+};
+typedef struct assembler_t assembler;
+
+static uint8_t asm_fail(assembler* a, unsigned line, const char* format, ...) {
+    if (a->err != NULL) {
+        va_list args;
+        va_start(args, format);
+        a->err->line = line;
+        vsnprintf(a->err->message, sizeof(a->err->message), format, args);
+        va_end(args);
+    }
+    return 1;
+}
+
+static inline char upper(char ch) {
+    return (ch >= 'a' && ch <= 'z') ? ch - 'a' + 'A' : ch;
+}
+
+static inline uint8_t is_space(char ch) {
+    return ch == ' ' || ch == '\t' || ch == '\r' || ch == ',';
+}
+
+static uint8_t mnemonic_lookup(const char* tok, size_t len) {
+    if (len < 2 || len > 4)
+        return MN_NONE;
+    uint32_t key = 0;
+    for (size_t i=0; i<len; i++)
+        key = key << 8 | (uint8_t)upper(tok[i]);
+    uint8_t mn = mnemonic_slots[MNEMONIC_SLOT(key)];
+    return (mn != MN_NONE && mnemonic_keys[mn] == key) ? mn : MN_NONE;
+}
+
+/*
+ * open addressing on the FNV-1a hash of the upper-cased name
+ * */
+static struct label_t* label_find(assembler* a, const char* name, size_t len, uint8_t insert) {
+    uint32_t h = 0x811c9dc5u;
+    for (size_t i=0; i<len; i++)
+        h = (h ^ (uint8_t)upper(name[i])) * 0x01000193u;
+
+    for (uint32_t i=h % LABEL_SLOTS; ; i=(i+1) % LABEL_SLOTS) {
+        struct label_t* l = &a->labels[i];
+        if (!l->used) {
+            if (!insert || a->num_labels == ASM_MAX_LABELS)
+                return NULL;
+            for (size_t j=0; j<len; j++)
+                l->name[j] = upper(name[j]);
+            l->name[len] = '\0';
+            l->used = 1;
+            a->num_labels++;
+            return l;
+        }
+        size_t j = 0;
+        while (j < len && l->name[j] == upper(name[j])) j++;
+        if (j == len && l->name[len] == '\0')
+            return l;
+    }
+}
+
+static uint8_t parse_number(const char* tok, size_t len, uint16_t* value) {
+    uint32_t v = 0;
+    size_t i = 0;
+    if (len > 2 && tok[0] == '0' && upper(tok[1]) == 'X') {
+        for (i=2; i<len; i++) {
+            char ch = upper(tok[i]);
+            if (ch >= '0' && ch <= '9')      v = v * 16 + ch - '0';
+            else if (ch >= 'A' && ch <= 'F') v = v * 16 + ch - 'A' + 10;
+            else return 0;
+            if (v > 0xFFFF) return 0;
+        }
+    } else {
+        for (i=0; i<len; i++) {
+            if (tok[i] < '0' || tok[i] > '9') return 0;
+            v = v * 10 + tok[i] - '0';
+            if (v > 0xFFFF) return 0;
+        }
+    }
+    *value = v;
+    return len > 0;
+}
+
+static uint8_t parse_operand(const char* tok, size_t len, operand* op) {
+    op->text = tok;
+    op->len = len;
+
+    if (tok[0] == '.') {
+        op->kind = OPD_LABEL;
+        return len > 1 && len <= ASM_LABEL_LEN;
+    }
+    if (len == 2 && upper(tok[0]) == 'V') {
+        char ch = upper(tok[1]);
+        if ((ch >= '0' && ch <= '9') || (ch >= 'A' && ch <= 'F')) {
+            op->kind = OPD_REG;
+            op->value = (ch <= '9') ? ch - '0' : ch - 'A' + 10;
+            return 1;
+        }
+    }
+    if (len == 1) {
+        switch (upper(tok[0])) {
+            case 'I': op->kind = OPD_I; return 1;
+            case 'K': op->kind = OPD_K; return 1;
+            case 'F': op->kind = OPD_F; return 1;
+            case 'B': op->kind = OPD_B; return 1;
+        }
+    }
+    if (len == 2 && upper(tok[1]) == 'T') {
+        if (upper(tok[0]) == 'D') { op->kind = OPD_DT; return 1; }
+        if (upper(tok[0]) == 'S') { op->kind = OPD_ST; return 1; }
+    }
+    if (len == 3 && tok[0] == '[' && upper(tok[1]) == 'I' && tok[2] == ']') {
+        op->kind = OPD_IIND;
+        return 1;
+    }
+    op->kind = OPD_NUM;
+    return parse_number(tok, len, &op->value);
+}
+
+static uint8_t emit(assembler* a, uint8_t byte) {
+    if (a->size == a->capacity)
+        return asm_fail(a, a->line, "program too large");
+    a->out[a->size++] = byte;
+    return 0;
+}
+
+static uint8_t fixup_add(assembler* a, const operand* op, uint8_t word) {
+    if (a->num_fixups == ASM_MAX_FIXUPS)
+        return asm_fail(a, a->line, "too many label references");
+    struct fixup_t* f = &a->fixups[a->num_fixups++];
+    f->name = op->text + 1;
+    f->len = op->len - 1;
+    f->word = word;
+    f->offset = a->size;
+    f->line = a->line;
+    return 0;
+}
+
+/*
+ * matches the operands against a pattern and builds the opcode,
+ * returns 0 if they don't fit
+ * */
+static uint8_t form_match(const char* pattern, const operand* ops, uint8_t n,
+                          uint16_t* opcode, const operand** label) {
+    uint8_t regs = 0;
+    uint8_t i;
+    *label = NULL;
+
+    for (i=0; pattern[i] && i<n; i++) {
+        const operand* op = &ops[i];
+        switch (pattern[i]) {
+            case 'v':
+                if (op->kind != OPD_REG) return 0;
+                *opcode |= op->value << (regs++ ? 4 : 8);
+                break;
+            case '0':
+                if (op->kind != OPD_REG || op->value != 0) return 0;
+                break;
+            case 'b':
+                if (op->kind != OPD_NUM || op->value > 0xFF) return 0;
+                *opcode |= op->value;
+                break;
+            case 'n':
+                if (op->kind != OPD_NUM || op->value > 0xF) return 0;
+                *opcode |= op->value;
+                break;
+            case 'a':
+                if (op->kind == OPD_LABEL) { *label = op; break; }
+                if (op->kind != OPD_NUM || op->value > 0xFFF) return 0;
+                *opcode |= op->value;
+                break;
+            case 'I': if (op->kind != OPD_I) return 0; break;
+            case 'D': if (op->kind != OPD_DT) return 0; break;
+            case 'S': if (op->kind != OPD_ST) return 0; break;
+            case 'K': if (op->kind != OPD_K) return 0; break;
+            case 'F': if (op->kind != OPD_F) return 0; break;
+            case 'B': if (op->kind != OPD_B) return 0; break;
+            case '[': if (op->kind != OPD_IIND) return 0; break;
+        }
+    }
+    return pattern[i] == '\0' && i == n;
+}
+
+static uint8_t assemble_data(assembler* a, uint8_t mn, const operand* ops, uint8_t n) {
+    for (uint8_t i=0; i<n; i++) {
+        const operand* op = &ops[i];
+        if (mn == MN_DW && op->kind == OPD_LABEL) {
+            if (fixup_add(a, op, 1) || emit(a, 0) || emit(a, 0))
+                return 1;
+        } else if (op->kind != OPD_NUM || (mn == MN_DB && op->value > 0xFF)) {
+            return asm_fail(a, a->line, "invalid data \"%.*s\"", op->len, op->text);
+        } else if (mn == MN_DB) {
+            if (emit(a, op->value))
+                return 1;
+        } else {
+            if (emit(a, op->value >> 8) || emit(a, op->value & 0xFF))
+                return 1;
+        }
+    }
+    return 0;
+}
+
+static uint8_t assemble_line(assembler* a, const char* p, const char* end) {
+    operand ops[MAX_OPERANDS];
+    uint8_t n = 0;
+    const char* tok;
+
+    while (p < end && is_space(*p)) p++;
+
+    /* a label marks the address of whatever follows */
+    if (p < end && *p == '.') {
+        tok = p;
+        while (p < end && !is_space(*p)) p++;
+        if (p - tok < 2 || p - tok > ASM_LABEL_LEN)
+            return asm_fail(a, a->line, "invalid label \"%.*s\"", (int)(p - tok), tok);
+        struct label_t* l = label_find(a, tok + 1, p - tok - 1, 0);
+        if (l != NULL)
+            return asm_fail(a, a->line, "label %s already defined", l->name);
+        l = label_find(a, tok + 1, p - tok - 1, 1);
+        if (l == NULL)
+            return asm_fail(a, a->line, "too many labels");
+        l->addr = PROGRAM_START + a->size;
+        while (p < end && is_space(*p)) p++;
+    }
+    if (p == end)
+        return 0;
+
+    tok = p;
+    while (p < end && !is_space(*p)) p++;
+    uint8_t mn = mnemonic_lookup(tok, p - tok);
+    if (mn == MN_NONE)
+        return asm_fail(a, a->line, "unknown instruction \"%.*s\"", (int)(p - tok), tok);
+    const char* name = tok;
+    int name_len = p - tok;
+
+    while (1) {
+        while (p < end && is_space(*p)) p++;
+        if (p == end)
+            break;
+        tok = p;
+        while (p < end && !is_space(*p)) p++;
+        if (n == MAX_OPERANDS || !parse_operand(tok, p - tok, &ops[n]))
+            return asm_fail(a, a->line, "invalid operand \"%.*s\"", (int)(p - tok), tok);
+        n++;
+    }
+
+    if (mn == MN_DB || mn == MN_DW)
+        return assemble_data(a, mn, ops, n);
+
+    for (uint8_t i=0; i<sizeof(forms)/sizeof(forms[0]); i++) {
+        if (forms[i].mnemonic != mn)
+            continue;
+        uint16_t opcode = forms[i].opcode;
+        const operand* label;
+        if (!form_match(forms[i].pattern, ops, n, &opcode, &label))
+            continue;
+        if (label != NULL && fixup_add(a, label, 0))
+            return 1;
+        return emit(a, opcode >> 8) || emit(a, opcode & 0xFF);
+    }
+    return asm_fail(a, a->line, "invalid operands for %.*s", name_len, name);
+}
+
+/*
+ * assembles source into out, returns 0 on success and sets size to
+ * the number of bytes written. on failure err holds the line and reason
+ * */
+uint8_t chip8_asm(const char* source, size_t len,
+                  uint8_t* out, size_t capacity, size_t* size, asm_error* err) {
+    assembler* a = calloc(1, sizeof(assembler));
+    if (a == NULL)
+        return 1;
+    a->out = out;
+    a->capacity = capacity;
+    a->err = err;
+
+    uint8_t status = 0;
+    const char* p = source;
+    const char* end = source + len;
+    while (p < end && status == 0) {
+        a->line++;
+        const char* eol = memchr(p, '\n', end - p);
+        if (eol == NULL)
+            eol = end;
+        const char* comment = memchr(p, ';', eol - p);
+        status = assemble_line(a, p, comment ? comment : eol);
+        p = eol + 1;
+    }
+
+    /* second pass over the label references */
+    for (unsigned i=0; i<a->num_fixups && status == 0; i++) {
+        struct fixup_t* f = &a->fixups[i];
+        struct label_t* l = label_find(a, f->name, f->len, 0);
+        if (l == NULL) {
+            status = asm_fail(a, f->line, "undefined label .%.*s", f->len, f->name);
+            break;
+        }
+        /* a label right after a full rom has no 12 bit address */
+        if (l->addr > MEM_MASK) {
+            status = asm_fail(a, f->line, "address out of range .%.*s", f->len, f->name);
+            break;
+        }
+        if (f->word)
+            out[f->offset] = l->addr >> 8;
+        else
+            out[f->offset] |= (l->addr >> 8) & 0x0F;
+        out[f->offset + 1] = l->addr & 0xFF;
+    }
+
+    *size = a->size;
+    free(a);
+    return status;
+}
+
+/*
+ * assembles straight into the memory of a chip8, as if the result
+ * had been loaded with chip8_program_load
+ * */
+uint8_t chip8_asm_load(chip8* c, const char* source, size_t len, asm_error* err) {
+    size_t size;
+    uint8_t* rom = c->memory + PROGRAM_START;
+    if (chip8_asm(source, len, rom, MEM_SIZE - PROGRAM_START, &size, err) != 0)
+        return 1;
+    chip8_rehash(c);
+    c->rom_hash = chip8_rom_hash(rom, size);
+    c->rom_size = size;
+    return 0;
+}
@@ -0,0 +1,39 @@
+#ifndef ASM_H
+#define ASM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "chip8.h"
+
+#define ASM_MAX_LABELS  1024
+#define ASM_MAX_FIXUPS  4096
+#define ASM_LABEL_LEN   32
+
+/*
+ * assembler for the syntax used by assemble.py and games/demo.asm8
+ *
+ *     ; comment
+ *     .LOOP                 label, refers to the next byte emitted
+ *     LD   I .SPRITE        labels can be used for any address operand
+ *     DRAW V0 V1 0x5
+ *     JMP  .LOOP
+ *     .SPRITE
+ *     DB   0xF0 0x90 0xF0   raw bytes
+ *     DW   0x1234 .LOOP     raw big-endian words
+ *
+ * the source is read in a single pass, references to labels that are
+ * not defined yet are recorded and patched once the whole source is
+ * encoded. the output is placed at PROGRAM_START
+ * */
+
+struct asm_error_t {
+    unsigned line;
+    char     message[96];
+};
+typedef struct asm_error_t asm_error;
+
+uint8_t chip8_asm(const char* source, size_t len,
+                  uint8_t* out, size_t capacity, size_t* size, asm_error* err);
+uint8_t chip8_asm_load(chip8* c, const char* source, size_t len, asm_error* err);
+
+#endif
@@ -0,0 +1,139 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "audio.h"
+
+#define WAV_HEADER_SIZE 44
+
+audio* audio_init(uint32_t sample_rate, uint32_t cycle_rate) {
+    audio* a;
+    if (posix_memalign((void**)&a, 64, sizeof(audio)) != 0)
+        return NULL;
+    memset(a, 0, sizeof(audio));
+
+    ring_init(&a->events);
+    a->sample_rate = sample_rate;
+    a->cycle_rate = cycle_rate;
+    a->phase_step = (uint32_t)(((uint64_t)TONE_FREQ << 32) / sample_rate);
+    return a;
+}
+
+/*
+ * routes the sound timer transitions of a chip8 into this audio output
+ * */
+void audio_attach(audio* a, chip8* c) {
+    c->sound_events = &a->events;
+}
+
+static void wav_put16(FILE* f, uint16_t v) {
+    fputc(v & 0xFF, f); fputc(v >> 8, f);
+}
+
+static void wav_put32(FILE* f, uint32_t v) {
+    wav_put16(f, v & 0xFFFF); wav_put16(f, v >> 16);
+}
+
+/*
+ * (re)writes the header of a mono 16-bit pcm wav file
+ * */
+static void wav_header_write(audio* a) {
+    FILE* f = a->wav;
+    uint32_t data_size = a->wav_samples * 2;
+
+    fseek(f, 0, SEEK_SET);
+    fwrite("RIFF", 1, 4, f); wav_put32(f, WAV_HEADER_SIZE - 8 + data_size);
+    fwrite("WAVE", 1, 4, f);
+    fwrite("fmt ", 1, 4, f); wav_put32(f, 16);
+    wav_put16(f, 1);                    /* pcm */
+    wav_put16(f, 1);                    /* mono */
+    wav_put32(f, a->sample_rate);
+    wav_put32(f, a->sample_rate * 2);   /* byte rate */
+    wav_put16(f, 2);                    /* block align */
+    wav_put16(f, 16);                   /* bits per sample */
+    fwrite("data", 1, 4, f); wav_put32(f, data_size);
+    fseek(f, 0, SEEK_END);
+}
+
+/*
+ * write everything rendered by audio_pump to a wav file
+ * */
+uint8_t audio_wav_open(audio* a, char* filename) {
+    a->wav = fopen(filename, "wb");
+    if (a->wav == NULL) {
+        fprintf(stderr, "could not open \"%s\"\n", filename);
+        return 1;
+    }
+    a->wav_samples = 0;
+    wav_header_write(a);
+    return 0;
+}
+
+void audio_free(audio* a) {
+    if (a->wav != NULL) {
+        wav_header_write(a);
+        fclose(a->wav);
+    }
+    free(a);
+}
+
+static inline uint64_t audio_cycle_to_sample(audio* a, uint64_t cycle) {
+    return cycle * a->sample_rate / a->cycle_rate;
+}
+
+/*
+ * renders n samples of square wave, applying each queued transition at
+ * the sample matching its cycle. transitions that are already late are
+ * applied at the start of the buffer
+ * */
+void audio_render(audio* a, int16_t* out, uint32_t n) {
+    uint32_t i = 0;
+    uint64_t event;
+
+    while (i < n) {
+        /* render up to the next transition or the end of the buffer */
+        uint32_t end = n;
+        if (ring_peek(&a->events, &event)) {
+            uint64_t at = audio_cycle_to_sample(a, event >> 1);
+            if (at <= a->sample_pos) {
+                a->on = event & 1;
+                ring_drop(&a->events);
+                continue;
+            }
+            if (at - a->sample_pos < n - i)
+                end = i + (at - a->sample_pos);
+        }
+
+        a->sample_pos += end - i;
+        if (a->on) {
+            for (; i < end; i++) {
+                out[i] = (a->phase < 0x80000000u) ? TONE_VOLUME : -TONE_VOLUME;
+                a->phase += a->phase_step;
+            }
+        } else {
+            memset(out + i, 0, (end - i) * sizeof(int16_t));
+            a->phase = 0;
+            i = end;
+        }
+    }
+}
+
+/*
+ * headless consumer: renders everything up to an emulated cycle into
+ * the wav file if one is open, or discards it otherwise
+ * */
+void audio_pump(audio* a, uint64_t cycle) {
+    int16_t buffer[512];
+    uint64_t target = audio_cycle_to_sample(a, cycle);
+
+    while (a->sample_pos < target) {
+        uint32_t n = sizeof(buffer) / sizeof(buffer[0]);
+        if (target - a->sample_pos < n)
+            n = target - a->sample_pos;
+        audio_render(a, buffer, n);
+        if (a->wav != NULL) {
+            fwrite(buffer, sizeof(int16_t), n, a->wav);
+            a->wav_samples += n;
+        }
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "chip8.h"
+#include "ring.h"
+
+#define SAMPLE_RATE 44100
+#define TONE_FREQ   440
+#define TONE_VOLUME 4000
+
+/*
+ * sound output
+ *
+ * the emulator pushes sound timer on/off transitions, stamped with the
+ * cycle they happened on, into an spsc ring (chip8.sound_events). the
+ * consumer turns them into a square wave, placing every transition on
+ * the sample that corresponds to its cycle. the consumer is either the
+ * sdl audio callback (audio_sdl.c) or audio_pump, which renders into a
+ * wav file or nowhere for headless runs
+ * */
+struct audio_t {
+    ring     events;
+
+    uint32_t sample_rate;
+    uint32_t cycle_rate;
+    uint32_t phase, phase_step;
+    uint64_t sample_pos;
+    uint8_t  on;
+
+    FILE*    wav;
+    uint32_t wav_samples;
+};
+typedef struct audio_t audio;
+
+audio*  audio_init(uint32_t sample_rate, uint32_t cycle_rate);
+void    audio_free(audio* a);
+void    audio_attach(audio* a, chip8* c);
+uint8_t audio_wav_open(audio* a, char* filename);
+void    audio_render(audio* a, int16_t* out, uint32_t n);
+void    audio_pump(audio* a, uint64_t cycle);
+
+uint8_t audio_sdl_open(audio* a);
+void    audio_sdl_close(audio* a);
+
+#endif
@@ -0,0 +1,36 @@
+#include <SDL/SDL.h>
+#include "audio.h"
+
+static void audio_sdl_callback(void* user, Uint8* stream, int len) {
+    audio_render((audio*)user, (int16_t*)stream, len / sizeof(int16_t));
+}
+
+/*
+ * plays the sound through sdl, the callback runs on sdl's audio thread
+ * and is the only consumer of the event ring
+ * */
+uint8_t audio_sdl_open(audio* a) {
+    SDL_AudioSpec spec;
+
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0)
+        return 1;
+
+    spec.freq = a->sample_rate;
+    spec.format = AUDIO_S16SYS;
+    spec.channels = 1;
+    spec.samples = 512;
+    spec.callback = audio_sdl_callback;
+    spec.userdata = a;
+
+    if (SDL_OpenAudio(&spec, NULL) != 0) {
+        fprintf(stderr, "could not open audio: %s\n", SDL_GetError());
+        return 1;
+    }
+    SDL_PauseAudio(0);
+    return 0;
+}
+
+void audio_sdl_close(audio* a) {
+    SDL_CloseAudio();
+    SDL_QuitSubSystem(SDL_INIT_AUDIO);
+}
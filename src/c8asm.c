@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "chip8.h"
+#include "asm.h"
+#include "disasm.h"
+#include "analyze.h"
+
+int disassemble = 0;
+int analyze = 0;
+char* cache_dir = NULL;
+
+static uint8_t* read_file(char* filename, size_t* size) {
+    FILE* f = fopen(filename, "rb");
+    if (f == NULL) {
+        fprintf(stderr, "could not find \"%s\"\n", filename);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    *size = ftell(f);
+    rewind(f);
+
+    uint8_t* buffer = malloc(*size + 1);
+    if (fread(buffer, 1, *size, f) != *size) {
+        fprintf(stderr, "could not read \"%s\"\n", filename);
+        free(buffer);
+        buffer = NULL;
+    }
+    fclose(f);
+    return buffer;
+}
+
+/*
+ * prints the basic blocks of a rom and which bytes are data, reusing
+ * a previous analysis from cache_dir unless it is NULL. returns 1 if
+ * the rom does not fit in memory or cannot be analysed
+ * */
+static uint8_t print_analysis(const char* name, uint8_t* rom, size_t size, const char* cache_dir) {
+    chip8* c = chip8_init();
+    if (c == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    if (chip8_program_load_mem(c, rom, size) != 0) {
+        fprintf(stderr, "\"%s\" does not fit in memory\n", name);
+        chip8_free(c);
+        return 1;
+    }
+
+    analysis* a = chip8_analyze_cached(c, cache_dir);
+    if (a == NULL) {
+        fprintf(stderr, "out of memory\n");
+        chip8_free(c);
+        return 1;
+    }
+    for (uint16_t i=0; i<a->num_blocks; i++) {
+        block* b = &a->blocks[i];
+        printf("block 0x%03X-0x%03X", b->start, b->end);
+        if (b->subroutine)
+            printf(" sub 0x%03X", a->subroutines[b->subroutine - 1]);
+        for (uint8_t j=0; j<b->num_succ; j++)
+            printf(" -> 0x%03X", b->succ[j]);
+        if (b->flags & BLOCK_RETURN)   printf(" ret");
+        if (b->flags & BLOCK_INDIRECT) printf(" indirect");
+        if (b->flags & BLOCK_HALT)     printf(" halt");
+        printf("\n");
+    }
+    for (uint16_t addr=PROGRAM_START; addr<PROGRAM_START + size; addr++) {
+        uint16_t start = addr;
+        while (addr < PROGRAM_START + size && !analysis_is_code(a, addr))
+            addr++;
+        if (addr > start)
+            printf("data  0x%03X-0x%03X\n", start, addr);
+    }
+
+    analysis_free(a);
+    chip8_free(c);
+    return 0;
+}
+
+/*
+ * c8asm source.asm8 rom.c8   assemble
+ * c8asm -d rom.c8            disassemble to stdout
+ * c8asm -a [-c dir] rom.c8   show control flow and data regions,
+ *                            cached in dir
+ * */
+int main(int argc, char** argv) {
+    int c;
+    while ((c = getopt(argc, argv, "ac:d")) != -1) {
+        switch (c) {
+            case 'a':
+                analyze = 1;
+                break;
+            case 'c':
+                cache_dir = optarg;
+                break;
+            case 'd':
+                disassemble = 1;
+                break;
+            default:
+                return 1;
+        }
+    }
+    if (optind + ((disassemble || analyze) ? 1 : 2) > argc) {
+        fprintf(stderr, "usage: %s source.asm8 rom.c8\n       %s -d rom.c8\n       %s -a [-c cache_dir] rom.c8\n",
+                argv[0], argv[0], argv[0]);
+        return 1;
+    }
+
+    size_t size;
+    uint8_t* input = read_file(argv[optind], &size);
+    if (input == NULL)
+        return 1;
+
+    if (analyze) {
+        uint8_t status = print_analysis(argv[optind], input, size, cache_dir);
+        free(input);
+        return status;
+    }
+
+    if (disassemble) {
+        chip8_disasm_rom(input, size, stdout);
+        free(input);
+        return 0;
+    }
+
+    uint8_t rom[MEM_SIZE - PROGRAM_START];
+    size_t rom_size;
+    asm_error err;
+    if (chip8_asm((char*)input, size, rom, sizeof(rom), &rom_size, &err) != 0) {
+        fprintf(stderr, "%s:%u: %s\n", argv[optind], err.line, err.message);
+        free(input);
+        return 1;
+    }
+    free(input);
+
+    FILE* f = fopen(argv[optind + 1], "wb");
+    if (f == NULL) {
+        fprintf(stderr, "could not open \"%s\"\n", argv[optind + 1]);
+        return 1;
+    }
+    fwrite(rom, 1, rom_size, f);
+    fclose(f);
+    return 0;
+}
@@ -0,0 +1,264 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "chip8.h"
+#include "corpus.h"
+#include "quirks.h"
+
+#define DEFAULT_CYCLES 100000
+#define MAX_WORKERS    64
+#define MAX_PATH_LEN   4096
+
+static const char* variant_names[] = {
+    [VARIANT_CHIP8]  = "chip8",
+    [VARIANT_SCHIP]  = "schip",
+    [VARIANT_XOCHIP] = "xochip",
+};
+
+static void usage(char* name) {
+    fprintf(stderr, "usage: %s add [-q quirks.db] [-c cache_dir] archive rom.c8... (- reads names from stdin)\n"
+                    "       %s list archive\n"
+                    "       %s run [-j jobs] [-n cycles] [-f] archive\n", name, name, name);
+}
+
+/*
+ * reads one rom and appends it, the buffer holds one byte more than
+ * fits in memory so oversized files are detected without a stat
+ * */
+static void add_file(corpus_writer* w, quirks_db* db, const char* filename, uint64_t* counts) {
+    uint8_t rom[MEM_SIZE - PROGRAM_START + 1];
+    FILE* f = fopen(filename, "rb");
+    if (f == NULL) {
+        fprintf(stderr, "could not open \"%s\"\n", filename);
+        counts[2]++;
+        return;
+    }
+    size_t size = fread(rom, 1, sizeof(rom), f);
+    fclose(f);
+
+    uint8_t quirks = 0;
+    if (db != NULL)
+        quirks_db_lookup(db, chip8_rom_hash(rom, size), &quirks);
+
+    int8_t added = corpus_writer_add(w, rom, size, quirks);
+    if (added == CORPUS_INVALID)
+        fprintf(stderr, "skipping \"%s\", it does not fit in memory\n", filename);
+    if (added == CORPUS_FAILED)
+        fprintf(stderr, "could not add \"%s\"\n", filename);
+    counts[added < 0 ? 2 : !added]++;
+}
+
+static int cmd_add(int argc, char** argv) {
+    quirks_db* db = NULL;
+    const char* cache_dir = NULL;
+    int c;
+    while ((c = getopt(argc, argv, "c:q:")) != -1) {
+        switch (c) {
+            case 'c': cache_dir = optarg; break;
+            case 'q':
+                db = quirks_db_load(optarg);
+                if (db == NULL)
+                    return 1;
+                break;
+            default:
+                return 1;
+        }
+    }
+    if (optind + 2 > argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    corpus_writer* w = corpus_writer_open(argv[optind]);
+    if (w == NULL) {
+        fprintf(stderr, "could not open archive \"%s\"\n", argv[optind]);
+        return 1;
+    }
+    w->cache_dir = cache_dir;
+
+    uint64_t counts[3] = {0};   /* added, duplicates, failed */
+    for (int i=optind + 1; i<argc && !w->failed; i++) {
+        if (strcmp(argv[i], "-") != 0) {
+            add_file(w, db, argv[i], counts);
+            continue;
+        }
+        char line[MAX_PATH_LEN];
+        while (!w->failed && fgets(line, sizeof(line), stdin) != NULL) {
+            line[strcspn(line, "\n")] = '\0';
+            if (line[0] != '\0')
+                add_file(w, db, line, counts);
+        }
+    }
+
+    if (db != NULL)
+        quirks_db_free(db);
+    if (corpus_writer_close(w) != 0) {
+        fprintf(stderr, "could not write archive \"%s\"\n", argv[optind]);
+        return 1;
+    }
+    printf("%llu added, %llu duplicates, %llu failed\n", (unsigned long long)counts[0],
+           (unsigned long long)counts[1], (unsigned long long)counts[2]);
+    return 0;
+}
+
+static int cmd_list(int argc, char** argv) {
+    if (optind + 1 != argc) {
+        usage(argv[0]);
+        return 1;
+    }
+    corpus* cp = corpus_open(argv[optind], 0);
+    if (cp == NULL) {
+        fprintf(stderr, "could not open archive \"%s\"\n", argv[optind]);
+        return 1;
+    }
+    for (uint64_t i=0; i<corpus_count(cp); i++) {
+        corpus_entry* e = &cp->entries[i];
+        printf("%016llx %5u %-6s quirks %02x", (unsigned long long)e->hash, e->size,
+               variant_names[e->variant], e->quirks);
+        if (e->result.key != 0)
+            printf("  %llu cycles%s%s", (unsigned long long)e->result.cycles,
+                   e->result.halted ? ", halted: " : "",
+                   e->result.halted ? chip8_error_name(e->result.err) : "");
+        printf("\n");
+    }
+    corpus_close(cp);
+    return 0;
+}
+
+struct runner_t {
+    corpus*  cp;
+    uint64_t next;            /* taken with an atomic add by the workers */
+    uint64_t cycles;
+    uint64_t key;             /* settings shared by every rom, see result_key */
+    uint8_t  force;
+    uint64_t ran, halted;
+    uint64_t failed;          /* taken by a worker without an instance */
+};
+typedef struct runner_t runner;
+
+/* key of a result for the settings of this run, never 0 */
+static uint64_t result_key(const runner* run, const corpus_entry* e) {
+    return chip8_hash_mix(run->key ^ e->quirks) | 1;
+}
+
+static void run_rom(chip8* c, corpus* cp, corpus_entry* e, runner* run) {
+    chip8_reset(c);
+    chip8_quirks_set(c, e->quirks);
+    chip8_program_load_mem(c, corpus_rom(cp, e), e->size);
+    while (c->cycles < run->cycles && !chip8_check_flag(c, HALT))
+        chip8_emulate_cycle(c);
+
+    corpus_result r = {
+        .key = result_key(run, e),
+        .state_hash = chip8_state_hash(c),
+        .cycles = c->cycles,
+        .err = c->err,
+        .halted = chip8_check_flag(c, HALT) != 0,
+    };
+    e->result = r;
+}
+
+static void* worker(void* arg) {
+    runner* run = arg;
+    chip8* c = chip8_init();
+
+    /* without an instance the worker still takes roms, so none is left uncounted */
+    for (;;) {
+        uint64_t i = __atomic_fetch_add(&run->next, 1, __ATOMIC_RELAXED);
+        if (i >= corpus_count(run->cp))
+            break;
+        corpus_entry* e = &run->cp->entries[i];
+        if (e->result.key == result_key(run, e) && !run->force)
+            continue;
+        if (c == NULL) {
+            __atomic_fetch_add(&run->failed, 1, __ATOMIC_RELAXED);
+            continue;
+        }
+        run_rom(c, run->cp, e, run);
+        __atomic_fetch_add(&run->ran, 1, __ATOMIC_RELAXED);
+        if (e->result.halted)
+            __atomic_fetch_add(&run->halted, 1, __ATOMIC_RELAXED);
+    }
+    if (c != NULL)
+        chip8_free(c);
+    return NULL;
+}
+
+/*
+ * runs every rom that has no result for the same settings yet, the
+ * results are written into the archive
+ * */
+static int cmd_run(int argc, char** argv) {
+    runner run = { .cycles = DEFAULT_CYCLES };
+    long num_workers = sysconf(_SC_NPROCESSORS_ONLN);
+    int c;
+    while ((c = getopt(argc, argv, "fj:n:")) != -1) {
+        switch (c) {
+            case 'f': run.force = 1; break;
+            case 'j': num_workers = strtol(optarg, NULL, 0); break;
+            case 'n': run.cycles = strtoull(optarg, NULL, 0); break;
+            default:
+                return 1;
+        }
+    }
+    if (optind + 1 != argc) {
+        usage(argv[0]);
+        return 1;
+    }
+    run.cp = corpus_open(argv[optind], 1);
+    if (run.cp == NULL) {
+        fprintf(stderr, "could not open archive \"%s\"\n", argv[optind]);
+        return 1;
+    }
+    run.key = chip8_hash_mix(run.cycles) ^
+              chip8_hash_mix((uint64_t)CHIP8_INTERP_VERSION << 32 | CORPUS_VERSION);
+
+    if (num_workers < 1) num_workers = 1;
+    if (num_workers > MAX_WORKERS) num_workers = MAX_WORKERS;
+
+    /* the roms are shared through run.next, so fewer threads only run slower */
+    pthread_t threads[MAX_WORKERS];
+    long started = 0;
+    while (started < num_workers && pthread_create(&threads[started], NULL, worker, &run) == 0)
+        started++;
+    if (started == 0)
+        worker(&run);
+    for (long i=0; i<started; i++)
+        pthread_join(threads[i], NULL);
+
+    printf("%llu roms, %llu cached, %llu ran, %llu halted\n",
+           (unsigned long long)corpus_count(run.cp),
+           (unsigned long long)(corpus_count(run.cp) - run.ran - run.failed),
+           (unsigned long long)run.ran, (unsigned long long)run.halted);
+    corpus_close(run.cp);
+    if (run.failed != 0) {
+        fprintf(stderr, "%llu roms not run, out of memory\n", (unsigned long long)run.failed);
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * c8corpus add|list|run ...
+ *
+ * builds and runs a packed rom archive, see corpus.h
+ * */
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        usage(argv[0]);
+        return 1;
+    }
+    char* cmd = argv[1];
+    argv[1] = argv[0];
+    argc--;
+    argv++;
+
+    if (!strcmp(cmd, "add"))  return cmd_add(argc, argv);
+    if (!strcmp(cmd, "list")) return cmd_list(argc, argv);
+    if (!strcmp(cmd, "run"))  return cmd_run(argc, argv);
+    usage(argv[0]);
+    return 1;
+}
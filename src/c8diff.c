@@ -0,0 +1,300 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "chip8.h"
+#include "reference.h"
+#include "disasm.h"
+#include "quirks.h"
+
+#define DEFAULT_CYCLES   1000000
+#define DEFAULT_INTERVAL 1000
+#define KEY_PERIOD       64     /* cycles between scripted key changes */
+#define REPORT_SIZE      2048
+#define MAX_WORKERS      64
+
+enum { DIFF_OK, DIFF_DIVERGED, DIFF_ERROR };
+
+struct job_t {
+    const char* filename;
+    uint8_t     result;
+    char        report[REPORT_SIZE];
+};
+typedef struct job_t job;
+
+struct runner_t {
+    job*     jobs;
+    uint32_t num_jobs;
+    uint32_t next_job;          /* taken with an atomic add by the workers */
+    uint64_t cycles;
+    uint32_t interval;
+    uint8_t  quirks;
+};
+typedef struct runner_t runner;
+
+/*
+ * the interpreter and the reference model with their snapshots
+ * at the last checkpoint where both agreed
+ * */
+struct engines_t {
+    chip8*   c;
+    chip8*   c_snap;
+    ref      r;
+    ref      r_snap;
+    uint64_t snap_cycle;
+};
+typedef struct engines_t engines;
+
+/*
+ * key states are a function of the rom and the cycle, so replaying
+ * from a snapshot presses the same keys. about one key in four is down
+ * */
+static uint16_t script_keys(uint64_t seed, uint64_t cycle) {
+    uint64_t a = chip8_hash_mix(seed ^ (cycle / KEY_PERIOD));
+    uint64_t b = chip8_hash_mix(a);
+    return (a & b) >> 16;
+}
+
+static void step(engines* e, uint64_t seed, uint64_t cycle) {
+    if (cycle % KEY_PERIOD == 0) {
+        uint16_t keys = script_keys(seed, cycle);
+        for (uint8_t k=0; k<NUM_KEYS; k++) {
+            chip8_key_set(e->c, k, (keys >> k) & 1);
+            e->r.keys[k] = (keys >> k) & 1;
+        }
+    }
+    chip8_emulate_cycle(e->c);
+    ref_step(&e->r);
+}
+
+static uint8_t states_equal(chip8* c, ref* r) {
+    return chip8_state_hash(c) == ref_state_hash(r)
+        && (chip8_check_flag(c, HALT) != 0) == r->halted;
+}
+
+static void snapshot(engines* e, uint64_t cycle) {
+    memcpy(e->c_snap, e->c, sizeof(chip8));
+    e->r_snap = e->r;
+    e->snap_cycle = cycle;
+}
+
+static void restore(engines* e) {
+    memcpy(e->c, e->c_snap, sizeof(chip8));
+    e->r = e->r_snap;
+}
+
+#define REPORT(...) do { \
+        if (pos < len) pos += snprintf(out + pos, len - pos, __VA_ARGS__); \
+    } while (0)
+
+/*
+ * describes every field that differs after the diverging instruction
+ * */
+static void report_divergence(chip8* c, ref* r, uint64_t cycle, uint16_t pc,
+                              char* out, size_t len) {
+    size_t pos = 0;
+    uint16_t op = c->memory[pc] << 8 | c->memory[(pc + 1) & MEM_MASK];
+    char text[32];
+    chip8_disasm(op, text, sizeof(text));
+
+    REPORT("diverged at cycle %llu, pc 0x%03X: %04X  %s\n",
+           (unsigned long long)cycle, pc, op, text);
+    size_t header = pos;
+
+    if (c->pc != r->pc) REPORT("  pc    0x%03X ref 0x%03X\n", c->pc, r->pc);
+    if (c->I != r->I)   REPORT("  I     0x%03X ref 0x%03X\n", c->I, r->I);
+    if (c->sp != r->sp) REPORT("  sp    %u ref %u\n", c->sp, r->sp);
+    if (c->delay_timer != r->dt) REPORT("  DT    %u ref %u\n", c->delay_timer, r->dt);
+    if (c->sound_timer != r->st) REPORT("  ST    %u ref %u\n", c->sound_timer, r->st);
+    if ((chip8_check_flag(c, HALT) != 0) != r->halted)
+        REPORT("  halt  %u ref %u\n", chip8_check_flag(c, HALT) != 0, r->halted);
+
+    for (uint8_t i=0; i<NUM_REGS; i++)
+        if (c->V[i] != r->V[i])
+            REPORT("  V%X    0x%02X ref 0x%02X\n", i, c->V[i], r->V[i]);
+    for (uint8_t i=0; i<c->sp && i<r->sp && i<STACK_SIZE; i++)
+        if (c->stack[i] != r->stack[i])
+            REPORT("  stack[%u] 0x%03X ref 0x%03X\n", i, c->stack[i], r->stack[i]);
+
+    uint16_t mem_diffs = 0;
+    for (uint16_t i=0; i<MEM_SIZE; i++)
+        if (c->memory[i] != r->mem[i] && mem_diffs++ < 8)
+            REPORT("  [%03X] 0x%02X ref 0x%02X\n", i, c->memory[i], r->mem[i]);
+    if (mem_diffs > 8)
+        REPORT("  ... %u bytes of memory differ\n", mem_diffs);
+
+    uint16_t gfx_diffs = 0;
+    for (uint16_t i=0; i<WIDTH*HEIGHT; i++)
+        gfx_diffs += c->gfx[i] != r->gfx[i];
+    if (gfx_diffs > 0)
+        REPORT("  %u pixels differ\n", gfx_diffs);
+
+    if (c->rng != r->rng)
+        REPORT("  rng   0x%08X ref 0x%08X\n", c->rng, r->rng);
+
+    /* nothing else differs, so one of the hashes is wrong */
+    if (pos == header)
+        REPORT("  state hash 0x%016llx ref 0x%016llx\n",
+               (unsigned long long)chip8_state_hash(c), (unsigned long long)ref_state_hash(r));
+}
+
+/*
+ * replays the window since the last agreeing checkpoint one cycle at a
+ * time to find the first instruction after which the engines differ
+ * */
+static void find_divergence(engines* e, uint64_t seed, uint64_t end, char* out, size_t len) {
+    restore(e);
+    for (uint64_t cycle=e->snap_cycle; cycle<end; cycle++) {
+        uint16_t pc = e->c->pc;
+        step(e, seed, cycle);
+        if (!states_equal(e->c, &e->r)) {
+            report_divergence(e->c, &e->r, cycle, pc, out, len);
+            return;
+        }
+    }
+    snprintf(out, len, "diverged before cycle %llu but the replay did not\n",
+             (unsigned long long)end);
+}
+
+static uint8_t diff_rom(runner* run, engines* e, job* j) {
+    uint8_t rom[MEM_SIZE - PROGRAM_START + 1];
+    FILE* f = fopen(j->filename, "rb");
+    if (f == NULL) {
+        snprintf(j->report, REPORT_SIZE, "could not open \"%s\"\n", j->filename);
+        return DIFF_ERROR;
+    }
+    size_t size = fread(rom, 1, sizeof(rom), f);
+    fclose(f);
+
+    chip8_reset(e->c);
+    ref_reset(&e->r, run->quirks);
+    if (chip8_program_load_mem(e->c, rom, size) != 0 || ref_load(&e->r, rom, size) != 0) {
+        snprintf(j->report, REPORT_SIZE, "\"%s\" does not fit in memory\n", j->filename);
+        return DIFF_ERROR;
+    }
+
+    uint64_t seed = e->c->rom_hash;
+    snapshot(e, 0);
+
+    uint64_t cycle = 0;
+    while (cycle < run->cycles) {
+        step(e, seed, cycle++);
+
+        uint8_t halted = chip8_check_flag(e->c, HALT) || e->r.halted;
+        if (cycle % run->interval != 0 && !halted && cycle != run->cycles)
+            continue;
+
+        if (!states_equal(e->c, &e->r)) {
+            find_divergence(e, seed, cycle, j->report, REPORT_SIZE);
+            return DIFF_DIVERGED;
+        }
+        if (halted)
+            break;
+        snapshot(e, cycle);
+    }
+
+    snprintf(j->report, REPORT_SIZE, "ok after %llu cycles%s\n",
+             (unsigned long long)cycle, chip8_check_flag(e->c, HALT) ? ", halted" : "");
+    return DIFF_OK;
+}
+
+static void* worker(void* arg) {
+    runner* run = arg;
+    engines* e = calloc(1, sizeof(engines));
+    uint8_t ok = e != NULL;
+    if (ok)
+        e->c = chip8_init();
+    if (ok && (e->c == NULL || posix_memalign((void**)&e->c_snap, 64, sizeof(chip8)) != 0)) {
+        e->c_snap = NULL;
+        ok = 0;
+    }
+    if (ok)
+        chip8_quirks_set(e->c, run->quirks);
+
+    /* without its engines the worker still takes jobs, so none is left unreported */
+    for (;;) {
+        uint32_t i = __atomic_fetch_add(&run->next_job, 1, __ATOMIC_RELAXED);
+        if (i >= run->num_jobs)
+            break;
+        if (ok) {
+            run->jobs[i].result = diff_rom(run, e, &run->jobs[i]);
+        } else {
+            snprintf(run->jobs[i].report, REPORT_SIZE, "out of memory\n");
+            run->jobs[i].result = DIFF_ERROR;
+        }
+    }
+
+    if (e != NULL) {
+        free(e->c_snap);
+        if (e->c != NULL)
+            chip8_free(e->c);
+        free(e);
+    }
+    return NULL;
+}
+
+/*
+ * c8diff [-j jobs] [-n cycles] [-i interval] [-q quirk]... rom.c8...
+ *
+ * runs every rom on the interpreter and the reference model in lockstep
+ * with scripted key presses, roms are spread over the worker threads
+ * */
+int main(int argc, char** argv) {
+    runner run = { .cycles = DEFAULT_CYCLES, .interval = DEFAULT_INTERVAL };
+    long num_workers = sysconf(_SC_NPROCESSORS_ONLN);
+
+    int c;
+    while ((c = getopt(argc, argv, "i:j:n:q:")) != -1) {
+        switch (c) {
+            case 'i': run.interval = strtoul(optarg, NULL, 0); break;
+            case 'j': num_workers = strtol(optarg, NULL, 0); break;
+            case 'n': run.cycles = strtoull(optarg, NULL, 0); break;
+            case 'q':
+                if (quirks_from_name(optarg) == 0) {
+                    fprintf(stderr, "unknown quirk \"%s\"\n", optarg);
+                    return 1;
+                }
+                run.quirks |= quirks_from_name(optarg);
+                break;
+            default:
+                return 1;
+        }
+    }
+    if (optind == argc || run.interval == 0) {
+        fprintf(stderr, "usage: %s [-j jobs] [-n cycles] [-i interval] [-q quirk]... rom.c8...\n", argv[0]);
+        return 1;
+    }
+
+    run.num_jobs = argc - optind;
+    run.jobs = calloc(run.num_jobs, sizeof(job));
+    if (run.jobs == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    for (uint32_t i=0; i<run.num_jobs; i++)
+        run.jobs[i].filename = argv[optind + i];
+
+    if (num_workers < 1) num_workers = 1;
+    if (num_workers > MAX_WORKERS) num_workers = MAX_WORKERS;
+    if (num_workers > run.num_jobs) num_workers = run.num_jobs;
+
+    /* the jobs are shared through run.next_job, so fewer threads only run slower */
+    pthread_t threads[MAX_WORKERS];
+    long started = 0;
+    while (started < num_workers && pthread_create(&threads[started], NULL, worker, &run) == 0)
+        started++;
+    if (started == 0)
+        worker(&run);
+    for (long i=0; i<started; i++)
+        pthread_join(threads[i], NULL);
+
+    uint32_t failed = 0;
+    for (uint32_t i=0; i<run.num_jobs; i++) {
+        printf("%s: %s", run.jobs[i].filename, run.jobs[i].report);
+        failed += run.jobs[i].result != DIFF_OK;
+    }
+    free(run.jobs);
+    return failed != 0;
+}
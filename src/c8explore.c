@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "chip8.h"
+#include "explore.h"
+#include "quirks.h"
+
+#define MAX_PATH 4096
+
+static const char* kind_names[] = {
+    [EXPLORE_ROOT]     = "start",
+    [EXPLORE_KEY_DOWN] = "key down",
+    [EXPLORE_KEY_UP]   = "key up",
+    [EXPLORE_KEY_WAIT] = "key wait",
+    [EXPLORE_RANDOM]   = "random",
+};
+
+static uint8_t goal_pc(chip8* c, void* user) {
+    return c->pc == *(uint16_t*)user;
+}
+
+static uint8_t* read_file(char* filename, size_t* size) {
+    FILE* f = fopen(filename, "rb");
+    if (f == NULL) {
+        fprintf(stderr, "could not find \"%s\"\n", filename);
+        return NULL;
+    }
+    uint8_t* buffer = malloc(MEM_SIZE);
+    if (buffer == NULL) {
+        fprintf(stderr, "out of memory\n");
+        fclose(f);
+        return NULL;
+    }
+    *size = fread(buffer, 1, MEM_SIZE, f);
+    fclose(f);
+    return buffer;
+}
+
+static void print_path(explore_node* goal) {
+    static explore_node* path[MAX_PATH];
+    uint32_t len = explore_path(goal, path, MAX_PATH);
+    printf("goal reached after %u branches:\n", len - 1);
+    for (uint32_t i=1; i<len && i<MAX_PATH; i++)
+        printf("  0x%03X %-8s 0x%X\n", path[i]->pc, kind_names[path[i]->kind], path[i]->value);
+}
+
+/*
+ * c8explore [-j jobs] [-n states] [-d depth] [-o bfs|dfs] [-g pc] [-q quirk]... rom.c8
+ *
+ * explores every state reachable under all key inputs and random draws,
+ * with -g it stops at the first state that reaches pc and prints the
+ * inputs leading there
+ * */
+int main(int argc, char** argv) {
+    explore_config cfg = { .workers = sysconf(_SC_NPROCESSORS_ONLN) };
+    uint16_t goal = 0;
+
+    int c;
+    while ((c = getopt(argc, argv, "d:g:j:n:o:q:")) != -1) {
+        switch (c) {
+            case 'd': cfg.max_depth = strtoul(optarg, NULL, 0); break;
+            case 'g':
+                goal = strtoul(optarg, NULL, 16) & MEM_MASK;
+                cfg.goal = goal_pc;
+                cfg.user = &goal;
+                break;
+            case 'j': cfg.workers = strtoul(optarg, NULL, 0); break;
+            case 'n': cfg.max_states = strtoul(optarg, NULL, 0); break;
+            case 'o':
+                if (!strcmp(optarg, "bfs")) {
+                    cfg.order = EXPLORE_BFS;
+                } else if (!strcmp(optarg, "dfs")) {
+                    cfg.order = EXPLORE_DFS;
+                } else {
+                    fprintf(stderr, "unknown order \"%s\"\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'q':
+                if (quirks_from_name(optarg) == 0) {
+                    fprintf(stderr, "unknown quirk \"%s\"\n", optarg);
+                    return 1;
+                }
+                cfg.quirks |= quirks_from_name(optarg);
+                break;
+            default:
+                return 1;
+        }
+    }
+    if (optind + 1 != argc) {
+        fprintf(stderr, "usage: %s [-j jobs] [-n states] [-d depth] [-o bfs|dfs] [-g pc] [-q quirk]... rom.c8\n", argv[0]);
+        return 1;
+    }
+
+    size_t size;
+    uint8_t* rom = read_file(argv[optind], &size);
+    if (rom == NULL)
+        return 1;
+
+    explore* e = explore_init(&cfg, rom, size);
+    free(rom);
+    if (e == NULL) {
+        fprintf(stderr, "could not explore \"%s\": it does not fit in memory or out of memory\n", argv[optind]);
+        return 1;
+    }
+    explore_run(e);
+
+    explore_stats stats;
+    explore_stats_get(e, &stats);
+    printf("%llu states, %llu duplicates, depth %u, %llu halted, %llu looping, %llu truncated, %llu KiB\n",
+           (unsigned long long)stats.states, (unsigned long long)stats.duplicates, stats.max_depth,
+           (unsigned long long)stats.halted, (unsigned long long)stats.loops,
+           (unsigned long long)stats.truncated, (unsigned long long)stats.bytes / 1024);
+
+    int result = 0;
+    if (cfg.goal != NULL) {
+        if (explore_goal(e) != NULL) {
+            print_path(explore_goal(e));
+        } else {
+            printf("goal 0x%03X not reached\n", goal);
+            result = 1;
+        }
+    }
+    explore_free(e);
+    return result;
+}
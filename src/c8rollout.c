@@ -0,0 +1,265 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "chip8.h"
+#include "rollout.h"
+#include "quirks.h"
+
+#define SEED          0x2545F491
+#define MAX_SPAN      8       /* frames a mutation holds one key for */
+#define TEMP_MIN      0.5
+#define TEMP_MAX      32.0
+#define HALT_PENALTY  256     /* below any byte a target can hold */
+
+/* the byte a run is scored by, a register or a memory address */
+struct target_t {
+    uint8_t  reg;
+    uint16_t addr;
+};
+
+struct replica_t {
+    uint16_t* keys;
+    int64_t   score;
+    double    temp;
+};
+
+static uint32_t rng_next(uint32_t* s) {
+    *s ^= *s << 13;
+    *s ^= *s >> 17;
+    *s ^= *s << 5;
+    return *s;
+}
+
+static double rng_unit(uint32_t* s) {
+    return (rng_next(s) >> 8) / (double)(1 << 24);
+}
+
+static uint64_t time_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static int64_t score_target(chip8* c, void* user) {
+    struct target_t* t = user;
+    int64_t s = t->reg < NUM_REGS ? c->V[t->reg] : c->memory[t->addr];
+    return chip8_check_flag(c, HALT) ? s - HALT_PENALTY : s;
+}
+
+static uint8_t* read_file(char* filename, size_t* size) {
+    FILE* f = fopen(filename, "rb");
+    if (f == NULL) {
+        fprintf(stderr, "could not find \"%s\"\n", filename);
+        return NULL;
+    }
+    uint8_t* buffer = malloc(MEM_SIZE);
+    if (buffer == NULL) {
+        fprintf(stderr, "out of memory\n");
+        fclose(f);
+        return NULL;
+    }
+    *size = fread(buffer, 1, MEM_SIZE, f);
+    fclose(f);
+    return buffer;
+}
+
+/* holds one key, or none, for a short run of frames */
+static void mutate(uint16_t* keys, uint32_t frames, uint32_t* rng) {
+    uint32_t f = rng_next(rng) % frames;
+    uint32_t span = 1 + rng_next(rng) % MAX_SPAN;
+    uint32_t k = rng_next(rng) % (NUM_KEYS + 1);
+    uint16_t mask = k < NUM_KEYS ? 1 << k : 0;
+    for (uint32_t i=f; i<f+span && i<frames; i++)
+        keys[i] = mask;
+}
+
+/* the sequence as runs of frames holding the same keys */
+static void print_keys(const uint16_t* keys, uint32_t frames) {
+    for (uint32_t f=0; f<frames; ) {
+        uint32_t end = f;
+        while (end < frames && keys[end] == keys[f])
+            end++;
+        if (keys[f] != 0)
+            printf("  frames %u-%u keys 0x%04X\n", f, end - 1, keys[f]);
+        f = end;
+    }
+}
+
+/*
+ * c8rollout [-j jobs] [-f frames] [-c cycles] [-r replicas] [-p proposals] [-i iterations] [-s Vx|addr] [-q quirk]... rom.c8
+ *
+ * searches for the key sequence that leaves the largest value in a
+ * register or memory byte after the given number of frames. every
+ * replica keeps a sequence at its own temperature, proposes mutations
+ * of it that are run in one batch and accepts them by the metropolis
+ * rule, then neighbouring temperatures swap sequences, so the hot
+ * replicas explore and the cold ones refine
+ * */
+int main(int argc, char** argv) {
+    rollout_config cfg = {
+        .workers = sysconf(_SC_NPROCESSORS_ONLN),
+        .cycles_per_frame = ROLLOUT_CYCLES_PER_FRAME,
+        .score = score_target,
+    };
+    struct target_t target = { .reg = 0 };
+    uint32_t frames = 600, num_replicas = 8, proposals = 64, iterations = 100;
+    uint8_t quirks = 0;
+
+    int c;
+    while ((c = getopt(argc, argv, "c:f:i:j:p:q:r:s:")) != -1) {
+        switch (c) {
+            case 'c': cfg.cycles_per_frame = strtoul(optarg, NULL, 0); break;
+            case 'f': frames = strtoul(optarg, NULL, 0); break;
+            case 'i': iterations = strtoul(optarg, NULL, 0); break;
+            case 'j': cfg.workers = strtoul(optarg, NULL, 0); break;
+            case 'p': proposals = strtoul(optarg, NULL, 0); break;
+            case 'r': num_replicas = strtoul(optarg, NULL, 0); break;
+            case 's':
+                if (optarg[0] == 'V' || optarg[0] == 'v') {
+                    target.reg = strtoul(optarg + 1, NULL, 16) & 0xF;
+                } else {
+                    target.reg = NUM_REGS;
+                    target.addr = strtoul(optarg, NULL, 16) & MEM_MASK;
+                }
+                break;
+            case 'q':
+                if (quirks_from_name(optarg) == 0) {
+                    fprintf(stderr, "unknown quirk \"%s\"\n", optarg);
+                    return 1;
+                }
+                quirks |= quirks_from_name(optarg);
+                break;
+            default:
+                return 1;
+        }
+    }
+    if (optind + 1 != argc || frames == 0 || num_replicas == 0 || proposals == 0) {
+        fprintf(stderr, "usage: %s [-j jobs] [-f frames] [-c cycles] [-r replicas] [-p proposals] [-i iterations] [-s Vx|addr] [-q quirk]... rom.c8\n", argv[0]);
+        return 1;
+    }
+    cfg.user = &target;
+
+    size_t size;
+    uint8_t* rom = read_file(argv[optind], &size);
+    if (rom == NULL)
+        return 1;
+    chip8* origin = chip8_init();
+    if (origin == NULL) {
+        fprintf(stderr, "out of memory\n");
+        free(rom);
+        return 1;
+    }
+    chip8_quirks_set(origin, quirks);
+    uint8_t err = chip8_program_load_mem(origin, rom, size);
+    free(rom);
+    if (err != 0) {
+        fprintf(stderr, "\"%s\" does not fit in memory\n", argv[optind]);
+        chip8_free(origin);
+        return 1;
+    }
+
+    rollout_pool* p = rollout_pool_init(&cfg);
+    if (p == NULL) {
+        fprintf(stderr, "could not start %u workers\n", cfg.workers);
+        chip8_free(origin);
+        return 1;
+    }
+
+    uint32_t num_jobs = num_replicas * proposals;
+    struct replica_t* replicas = calloc(num_replicas, sizeof(struct replica_t));
+    uint16_t* best = calloc(frames, sizeof(uint16_t));
+    uint16_t* keys = calloc((size_t)num_jobs * frames, sizeof(uint16_t));
+    rollout_job* jobs = calloc(num_jobs, sizeof(rollout_job));
+    uint8_t ok = replicas != NULL && best != NULL && keys != NULL && jobs != NULL;
+    for (uint32_t r=0; ok && r<num_replicas; r++) {
+        replicas[r].keys = calloc(frames, sizeof(uint16_t));
+        ok = replicas[r].keys != NULL;
+    }
+    if (!ok) {
+        fprintf(stderr, "out of memory\n");
+        rollout_pool_free(p);
+        for (uint32_t r=0; replicas != NULL && r<num_replicas; r++)
+            free(replicas[r].keys);
+        free(replicas);
+        free(jobs);
+        free(keys);
+        free(best);
+        chip8_free(origin);
+        return 1;
+    }
+    uint32_t rng = SEED;
+
+    /* every replica starts from no keys at all */
+    rollout_job idle = { .keys = best, .frames = frames };
+    rollout_run(p, origin, &idle, 1);
+    int64_t best_score = idle.score;
+    for (uint32_t r=0; r<num_replicas; r++) {
+        replicas[r].score = idle.score;
+        replicas[r].temp = num_replicas > 1 ?
+            TEMP_MIN * pow(TEMP_MAX / TEMP_MIN, (double)r / (num_replicas - 1)) : TEMP_MIN;
+    }
+
+    uint64_t start = time_us();
+    uint64_t frames_run = 0;
+    for (uint32_t it=0; it<iterations; it++) {
+        for (uint32_t i=0; i<num_jobs; i++) {
+            uint16_t* k = keys + (size_t)i * frames;
+            memcpy(k, replicas[i / proposals].keys, frames * sizeof(uint16_t));
+            mutate(k, frames, &rng);
+            jobs[i] = (rollout_job) { .keys = k, .frames = frames };
+        }
+        rollout_run(p, origin, jobs, num_jobs);
+
+        for (uint32_t r=0; r<num_replicas; r++) {
+            struct replica_t* rep = &replicas[r];
+            rollout_job* pick = &jobs[r * proposals];
+            for (uint32_t i=0; i<proposals; i++) {
+                rollout_job* j = &jobs[r * proposals + i];
+                frames_run += j->cycles / p->cfg.cycles_per_frame;
+                if (j->score > pick->score)
+                    pick = j;
+            }
+            if (pick->score >= rep->score || rng_unit(&rng) < exp((pick->score - rep->score) / rep->temp)) {
+                memcpy(rep->keys, pick->keys, frames * sizeof(uint16_t));
+                rep->score = pick->score;
+            }
+            if (rep->score > best_score) {
+                best_score = rep->score;
+                memcpy(best, rep->keys, frames * sizeof(uint16_t));
+            }
+        }
+
+        for (uint32_t r=0; r+1<num_replicas; r++) {
+            struct replica_t* a = &replicas[r];
+            struct replica_t* b = &replicas[r + 1];
+            double d = (b->score - a->score) * (1 / a->temp - 1 / b->temp);
+            if (d >= 0 || rng_unit(&rng) < exp(d)) {
+                struct replica_t t = *a;
+                a->keys = b->keys;
+                a->score = b->score;
+                b->keys = t.keys;
+                b->score = t.score;
+            }
+        }
+    }
+    uint64_t elapsed = time_us() - start;
+
+    printf("best score %lld after %u iterations, %llu frames in %.2fs, %.0f frames/s\n",
+           (long long)best_score, iterations, (unsigned long long)frames_run,
+           elapsed / 1e6, elapsed ? frames_run * 1e6 / elapsed : 0.0);
+    print_keys(best, frames);
+
+    rollout_pool_free(p);
+    for (uint32_t r=0; r<num_replicas; r++)
+        free(replicas[r].keys);
+    free(replicas);
+    free(jobs);
+    free(keys);
+    free(best);
+    chip8_free(origin);
+    return 0;
+}
@@ -1,15 +1,58 @@
 #include <stdint.h>
-#include <stdarg.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include "chip8.h"
+#include "ring.h"
+#include "metrics.h"
 
 /*
- * sets the initial state of a chip8
+ * allocates a chip8 on a cache line boundary, see struct chip8_t,
+ * and sets its initial state
  * */
 chip8* chip8_init() {
-    chip8* c = malloc(sizeof(chip8));
+    chip8* c;
+    if (posix_memalign((void**)&c, 64, sizeof(chip8)) != 0)
+        return NULL;
 
+    c->flags = 0;
+    c->watch_pages = 0;
+    c->watch = NULL;
+    c->sound_events = NULL;
+    c->log = NULL;
+    c->log_user = NULL;
+    if (posix_memalign((void**)&c->counters, 64, sizeof(chip8_counters)) != 0) {
+        free(c);
+        return NULL;
+    }
+    memset(c->counters, 0, sizeof(chip8_counters));
+    chip8_quirks_set(c, 0);
+    chip8_reset(c);
+
+    return c;
+}
+
+/*
+ * hash of the state right after a reset, where only the font is
+ * nonzero. computed on first use, every thread computes the same value
+ * */
+static uint64_t reset_hash() {
+    static uint64_t hash;
+    uint64_t h = __atomic_load_n(&hash, __ATOMIC_RELAXED);
+    if (h == 0) {
+        for (uint16_t i=0; i<CHARSET_SIZE; i++)
+            h ^= chip8_hash_key(HASH_MEM + CHARSET_START + i, font_charset[i]);
+        __atomic_store_n(&hash, h, __ATOMIC_RELAXED);
+    }
+    return h;
+}
+
+/*
+ * sets the initial state of a chip8 without reallocating it. quirks,
+ * watchpoints, the sound output, the counters and the log callback
+ * are kept
+ * */
+void chip8_reset(chip8* c) {
     c->opcode = 0;
     c->I = 0;
     c->pc = PROGRAM_START;
@@ -19,30 +62,122 @@ chip8* chip8_init() {
     c->flags = 0;
     c->waiting_for_key = 0;
     c->key_pressed = -1;
+    c->err = ERR_NONE;
+    c->err_pc = 0;
+    c->err_opcode = 0;
+    c->rom_hash = 0;
+    c->rom_size = 0;
+    c->cycles = 0;
+    c->rng = RNG_SEED;
+    c->sound_on = 0;
+
+    memset(c->V, 0, sizeof(c->V));
+    memset(c->gfx, 0, sizeof(c->gfx));
+    memset(c->stack, 0, sizeof(c->stack));
+    memset(c->keys, 0, sizeof(c->keys));
+    memset(c->memory, 0, sizeof(c->memory));
+    memcpy(c->memory + CHARSET_START, font_charset, CHARSET_SIZE);
+    c->hash = reset_hash();
+}
 
-    uint16_t i;
-    for (i=0; i<NUM_REGS; i++)     chip8_reg_set(c, i, 0);
-    for (i=0; i<WIDTH*HEIGHT; i++) c->gfx[i] = 0;
-    for (i=0; i<STACK_SIZE; i++)   c->stack[i] = 0;
-    for (i=0; i<NUM_KEYS; i++)     c->keys[i] = 0;
-    for (i=0; i<MEM_SIZE; i++)     chip8_mem_write8(c,i,0);
-    for (i=0; i<CHARSET_SIZE; i++) chip8_mem_write8(c,CHARSET_START + i, font_charset[i]);
+/*
+ * copies the machine state of src into dst, a flat copy of everything
+ * up to the instance owned pointers at the end of the struct. dst keeps
+ * its own counters, watchpoints, sound output and log callback
+ * */
+void chip8_clone(chip8* dst, const chip8* src) {
+    struct chip8_counters_t* counters = dst->counters;
+    uint16_t watch_pages = dst->watch_pages;
 
-    return c;
+    memcpy(dst, src, offsetof(chip8, watch));
+    dst->counters = counters;
+    dst->watch_pages = watch_pages;
 }
 
 /*
- * print an error message and set halt flag
+ * recomputes the state hash from scratch, needed after memory,
+ * registers, gfx or the stack are written without the accessors
  * */
-void chip8_error(chip8* c, char* format, ...) {
-    char buffer[256];
-    va_list args;
-    va_start(args, format);
-    vsnprintf(buffer, 256, format, args);
-    va_end(args);
-    perror(buffer);
+void chip8_rehash(chip8* c) {
+    uint64_t h = 0;
+    for (uint16_t i=0; i<MEM_SIZE; i++)
+        h ^= chip8_hash_key(HASH_MEM + i, c->memory[i]);
+    for (uint8_t i=0; i<NUM_REGS; i++)
+        h ^= chip8_hash_key(HASH_REG + i, c->V[i]);
+    for (uint16_t i=0; i<WIDTH*HEIGHT; i++)
+        h ^= chip8_hash_key(HASH_GFX + i, c->gfx[i]);
+    for (uint8_t i=0; i<c->sp && i<STACK_SIZE; i++)
+        h ^= chip8_hash_key(HASH_STACK + i, c->stack[i]);
+    c->hash = h;
+}
 
+/*
+ * halts and records why and where, this is a few stores on the
+ * emulation thread. the message is only formatted if the log
+ * callback asks for it through chip8_strerror
+ * */
+void chip8_error(chip8* c, uint8_t err) {
     c->flags |= HALT;
+    c->err = err;
+    c->err_pc = c->pc;
+    c->err_opcode = c->opcode;
+    counter_add(&c->counters->halts, 1);
+    counter_add(&c->counters->errors[err], 1);
+    if (c->log != NULL)
+        c->log(c, c->log_user);
+}
+
+static const char* error_names[NUM_ERRORS] = {
+    [ERR_NONE]            = "none",
+    [ERR_INVALID_OPCODE]  = "invalid_opcode",
+    [ERR_STACK_OVERFLOW]  = "stack_overflow",
+    [ERR_STACK_UNDERFLOW] = "stack_underflow",
+};
+
+const char* chip8_error_name(uint8_t err) {
+    return err < NUM_ERRORS ? error_names[err] : "unknown";
+}
+
+/*
+ * formats the last error into buf
+ * */
+char* chip8_strerror(chip8* c, char* buf, size_t len) {
+    switch (c->err) {
+        case ERR_NONE:
+            snprintf(buf, len, "no error");
+            break;
+        case ERR_INVALID_OPCODE:
+            snprintf(buf, len, "invalid opcode 0x%04X at 0x%03X", c->err_opcode, c->err_pc);
+            break;
+        case ERR_STACK_OVERFLOW:
+            snprintf(buf, len, "stack overflow calling 0x%03X at 0x%03X", c->err_opcode & 0x0FFF, c->err_pc);
+            break;
+        case ERR_STACK_UNDERFLOW:
+            snprintf(buf, len, "return with empty stack at 0x%03X", c->err_pc);
+            break;
+        default:
+            snprintf(buf, len, "unknown error %u at 0x%03X", c->err, c->err_pc);
+            break;
+    }
+    return buf;
+}
+
+/*
+ * copy a program image into memory at PROGRAM_START, the hash is only
+ * updated for the bytes written
+ * */
+uint8_t chip8_program_load_mem(chip8* c, const uint8_t* data, size_t size) {
+    if (size > MEM_SIZE - PROGRAM_START)
+        return 1;
+
+    uint8_t* rom = c->memory + PROGRAM_START;
+    for (size_t i=0; i<size; i++)
+        c->hash ^= chip8_hash_key(HASH_MEM + PROGRAM_START + i, rom[i]) ^
+                   chip8_hash_key(HASH_MEM + PROGRAM_START + i, data[i]);
+    memcpy(rom, data, size);
+    c->rom_hash = chip8_rom_hash(data, size);
+    c->rom_size = size;
+    return 0;
 }
 
 /*
@@ -57,46 +192,85 @@ uint8_t chip8_program_load(chip8* c, char* filename) {
         return 1;
     }
 
-    // get file size
-    fseek(f, 0, SEEK_END);
-    uint16_t size = ftell(f);
+    // get file size, pipes and other unseekable files are rejected
+    long size = -1;
+    if (fseek(f, 0, SEEK_END) == 0)
+        size = ftell(f);
+    if (size < 0) {
+        fprintf(stderr, "could not get the size of \"%s\"\n", filename);
+        fclose(f);
+        return 1;
+    }
     rewind(f);
 
-    if (size > MEM_SIZE - PROGRAM_START) {
-        fprintf(stderr, "Not enough memory: %i", size);
+    uint8_t buffer[MEM_SIZE - PROGRAM_START];
+    if (size > (long)sizeof(buffer)) {
+        fprintf(stderr, "Not enough memory: %li\n", size);
+        fclose(f);
         return 1;
     }
 
-    // allocate buffer
-    uint8_t* buffer = malloc(sizeof(uint8_t) * size);
-
     // copy file into buffer
-    fread(buffer, 1, size, f);
+    size_t read = fread(buffer, 1, size, f);
+    uint8_t failed = ferror(f) || read != (size_t)size;
+    fclose(f);
+    if (failed) {
+        fprintf(stderr, "could not read \"%s\"\n", filename);
+        return 1;
+    }
 
-    for (uint16_t i=0; i<size; i++) {
-        c->memory[i+PROGRAM_START] = buffer[i];
+    return chip8_program_load_mem(c, buffer, read);
+}
+
+/*
+ * 64-bit FNV-1a hash of a rom image, used as key for per-rom settings
+ * */
+uint64_t chip8_rom_hash(const uint8_t* data, size_t size) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i=0; i<size; i++) {
+        h ^= data[i];
+        h *= 0x100000001b3ULL;
     }
-    return 0;
+    return h;
 }
 
 /*
- * will only increment pc if key press is registered
+ * stores the lowest pressed key in Vx, returns 0 while no key is
+ * pressed so Fx0A can keep pc on itself
  * */
-uint8_t chip8_wait_for_key(chip8* c) {
-    // TODO
-    chip8_pc_incr(c);
+uint8_t chip8_wait_for_key(chip8* c, uint8_t x) {
+    for (uint8_t key=0; key<NUM_KEYS; key++) {
+        if (chip8_key_get(c, key)) {
+            chip8_reg_set(c, x, key);
+            c->key_pressed = key;
+            c->waiting_for_key = 0;
+            return 1;
+        }
+    }
+    c->waiting_for_key = 1;
     return 0;
 }
 
+/*
+ * the sound is on while the sound timer is nonzero, transitions are
+ * queued for the audio thread and dropped if it has fallen behind
+ * */
 void chip8_update_timers(chip8* c) {
+    if (c->delay_timer > 0 || c->sound_timer > 0)
+        counter_add(&c->counters->timer_ticks, 1);
+
     if (c->delay_timer > 0)
         c->delay_timer--;
 
-    if (c->sound_timer > 0) {
-        if (c->sound_timer == 1)
-            printf("BEEP\n");
-        c->sound_timer--;
+    uint8_t on = c->sound_timer > 0;
+    if (on != c->sound_on) {
+        c->sound_on = on;
+        if (c->sound_events != NULL)
+            ring_push(c->sound_events, c->cycles << 1 | on);
     }
+
+    if (c->sound_timer > 0)
+        c->sound_timer--;
 }
 
 void chip8_debug_print(chip8* c) {
@@ -139,4 +313,6 @@ void chip8_emulate_cycle(chip8* c) {
     chip8_opcode_fetch(c);
     chip8_opcode_exec(c);
     chip8_update_timers(c);
+    c->cycles++;
+    counter_add(&c->counters->instructions, 1);
 }
@@ -3,8 +3,11 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <stddef.h>
 
 #define MEM_SIZE      4096
+#define MEM_MASK      (MEM_SIZE - 1)
+#define PAGE_SHIFT    8
 #define BYTES_PER_CHAR 5
 #define CHARSET_SIZE  80
 #define CHARSET_START 0x050
@@ -18,8 +21,41 @@
 #define WIDTH         64
 #define HEIGHT        32
 
-#define HALT 1
-#define DRAW 2
+#define HALT  1
+#define DRAW  2
+
+/* why chip8_error halted the machine, see chip8_strerror */
+enum {
+    ERR_NONE,
+    ERR_INVALID_OPCODE,
+    ERR_STACK_OVERFLOW,     /* 2nnn with a full stack */
+    ERR_STACK_UNDERFLOW,    /* 00EE with an empty stack */
+    NUM_ERRORS
+};
+
+/* positions of the state in the incremental hash, see chip8_hash_key */
+#define HASH_MEM      0x0000
+#define HASH_REG      0x1000
+#define HASH_GFX      0x1100
+#define HASH_STACK    0x1900
+
+#define RNG_SEED      0x9E3779B9
+
+/*
+ * bumped whenever an opcode changes what it does, results stored by an
+ * older interpreter (see corpus_result) are then run again
+ * */
+#define CHIP8_INTERP_VERSION 2
+
+#define WATCH_READ  1
+#define WATCH_WRITE 2
+
+/* compatibility quirks, see quirks.h */
+#define QUIRK_SHIFT_VY      0x01
+#define QUIRK_LOAD_STORE_I  0x02
+#define QUIRK_JUMP_VX       0x04
+#define QUIRK_CLIP          0x08
+#define QUIRK_VF_RESET      0x10
 
 const static uint8_t font_charset[CHARSET_SIZE] = {
     0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
@@ -40,36 +76,117 @@ const static uint8_t font_charset[CHARSET_SIZE] = {
     0xF0, 0x80, 0xF0, 0x80, 0x80  // F
 };
 
+/*
+ * everything a typical instruction touches is in the first cache line,
+ * the stack and keys share the next one and the dispatch table, memory
+ * and the framebuffer each start on a line of their own, so instances
+ * interleaved on one core only pull in the lines they use. fields that
+ * are only used on errors, watchpoints or rom loads come last
+ * */
 struct chip8_t {
+    /* cpu state, one cache line */
     uint16_t opcode, I, pc;
     uint8_t  sp;
     uint8_t  delay_timer, sound_timer;
     uint8_t  flags;
+    uint8_t  quirks;
+    uint8_t  sound_on;
+    uint16_t watch_pages;     /* one bit per page with a watchpoint */
     uint8_t  waiting_for_key, key_pressed;
-
-    uint8_t  memory[MEM_SIZE];
     uint8_t  V[NUM_REGS];
-    uint8_t  gfx[WIDTH * HEIGHT];
-    uint16_t stack[STACK_SIZE];
+    uint32_t rng;             /* xorshift32 state for Cxkk */
+    uint64_t cycles;
+    uint64_t hash;            /* incremental hash of memory, V, gfx and stack, see chip8_hash_key */
+    struct chip8_counters_t* counters; /* kept across resets, see metrics.h */
+
+    uint16_t stack[STACK_SIZE] __attribute__((aligned(64)));
     uint8_t  keys[NUM_KEYS];
+    void     (*ops[16])(struct chip8_t*) __attribute__((aligned(64)));
+
+    uint8_t  memory[MEM_SIZE] __attribute__((aligned(64)));
+    uint8_t  gfx[WIDTH * HEIGHT] __attribute__((aligned(64)));
+
+    /* cold */
+    uint64_t rom_hash;
+    uint16_t rom_size;
+    uint8_t  err;             /* ERR_* of the chip8_error that halted */
+    uint16_t err_pc, err_opcode;
+    /* owned by the instance, not copied by chip8_clone */
+    struct watch_t* watch;
+    struct ring_t* sound_events; /* sound on/off transitions, see audio.h */
 
-} chip8_t;
+    /* called after chip8_error has halted, nothing is logged when NULL */
+    void     (*log)(struct chip8_t* c, void* user);
+    void*    log_user;
+};
 typedef struct chip8_t chip8;
+typedef void (*chip8_func_ptr)(chip8*);
+
+_Static_assert(offsetof(chip8, counters) + sizeof(void*) <= 64, "cpu state must fit in one cache line");
+_Static_assert(offsetof(chip8, stack) == 64, "stack and keys must start the second cache line");
+_Static_assert(offsetof(chip8, keys) + NUM_KEYS <= 128, "stack and keys must share a cache line");
+_Static_assert(offsetof(chip8, ops) % 64 == 0, "dispatch table must be cache line aligned");
+_Static_assert(offsetof(chip8, memory) % 64 == 0, "memory must be cache line aligned");
+_Static_assert(offsetof(chip8, gfx) % 64 == 0, "gfx must be cache line aligned");
 
 chip8*   chip8_init();
-void     chip8_error(chip8* c, char* format, ...);
+void     chip8_reset(chip8* c);
+void     chip8_clone(chip8* dst, const chip8* src);
+void     chip8_error(chip8* c, uint8_t err);
+char*    chip8_strerror(chip8* c, char* buf, size_t len);
+const char* chip8_error_name(uint8_t err);
 uint8_t  chip8_program_load(chip8* c, char* filename);
+uint8_t  chip8_program_load_mem(chip8* c, const uint8_t* data, size_t size);
+uint64_t chip8_rom_hash(const uint8_t* data, size_t size);
 void     chip8_debug_print(chip8* c);
 void     chip8_emulate_cycle(chip8* c);
 void     chip8_opcode_fetch(chip8* c);
 void     chip8_opcode_exec(chip8* c);
-uint8_t  chip8_wait_for_key(chip8* c);
+void     chip8_quirks_set(chip8* c, uint8_t quirks);
+uint8_t  chip8_wait_for_key(chip8* c, uint8_t x);
+void     chip8_rehash(chip8* c);
 void     chip8_mem_dump(chip8* c);
+void     chip8_watch_hit(chip8* c, uint16_t addr, uint8_t access);
 
 static inline uint8_t  chip8_check_flag(chip8* c, uint8_t flag) { return c->flags & flag; }
 
-static inline void chip8_mem_write8(chip8* c, uint16_t addr, uint8_t val) { c->memory[addr] = val; }
-static inline uint8_t chip8_mem_read8(chip8* c, uint16_t addr) { return c->memory[addr]; }
+/* splitmix64 finalizer */
+static inline uint64_t chip8_hash_mix(uint64_t z) {
+    z *= 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/*
+ * the large parts of the state are hashed as the xor of one key per
+ * nonzero element, so a write only has to remove the key of the old
+ * value and add the new one. gfx pixels are 0 or 1, so a flip is a
+ * single xor, and only the live part of the stack is included
+ * */
+static inline uint64_t chip8_hash_key(uint16_t pos, uint16_t val) {
+    return val ? chip8_hash_mix((uint64_t)pos << 16 | val) : 0;
+}
+
+/*
+ * all memory accesses are masked to the 4K address space, so an
+ * out-of-range I or pc wraps around instead of running off the array.
+ * the watchpoint test is a single bit test that only leaves the fast
+ * path on pages that have watchpoints
+ * */
+static inline void chip8_mem_write8(chip8* c, uint16_t addr, uint8_t val) {
+    addr &= MEM_MASK;
+    if (c->watch_pages & (1 << (addr >> PAGE_SHIFT)))
+        chip8_watch_hit(c, addr, WATCH_WRITE);
+    c->hash ^= chip8_hash_key(HASH_MEM + addr, c->memory[addr]) ^ chip8_hash_key(HASH_MEM + addr, val);
+    c->memory[addr] = val;
+}
+static inline uint8_t chip8_mem_read8(chip8* c, uint16_t addr) {
+    addr &= MEM_MASK;
+    if (c->watch_pages & (1 << (addr >> PAGE_SHIFT)))
+        chip8_watch_hit(c, addr, WATCH_READ);
+    return c->memory[addr];
+}
 static inline void chip8_mem_write16(chip8* c, uint16_t addr, uint16_t val) {
     chip8_mem_write8(c,addr, (val >> 8) & 0xFF);
     chip8_mem_write8(c,addr + 1, val & 0xFF);
@@ -78,8 +195,8 @@ static inline uint16_t chip8_mem_read16(chip8* c, uint16_t addr) {
     return (chip8_mem_read8(c,addr) << 8 | chip8_mem_read8(c,addr + 1));
 }
 
-static inline void     chip8_free(chip8* c) { free(c); }
-static inline uint16_t chip8_char_get(chip8* c, uint8_t ch) { return CHARSET_START + ch * BYTES_PER_CHAR; }
+static inline void     chip8_free(chip8* c) { free(c->watch); free(c->counters); free(c); }
+static inline uint16_t chip8_char_get(chip8* c, uint8_t ch) { return CHARSET_START + (ch & 0xF) * BYTES_PER_CHAR; }
 
 //static inline void     chip8_opcode_fetch(chip8* c) { c->opcode = chip8_mem_read16(c, c->pc); }
 
@@ -90,11 +207,47 @@ static inline void     chip8_pc_incr(chip8* c) { chip8_pc_set(c, chip8_pc_get(c)
 static inline void     chip8_index_set(chip8* c, uint16_t val) { c->I = val % MEM_SIZE; }
 static inline uint16_t chip8_index_get(chip8* c) { return c->I; }
 
-static inline void     chip8_reg_set(chip8* c, uint8_t x, uint8_t val) { c->V[x] = val; }
+static inline void     chip8_reg_set(chip8* c, uint8_t x, uint8_t val) {
+    c->hash ^= chip8_hash_key(HASH_REG + x, c->V[x]) ^ chip8_hash_key(HASH_REG + x, val);
+    c->V[x] = val;
+}
 static inline uint8_t  chip8_reg_get(chip8* c, uint8_t x) { return c->V[x]; }
 
-static inline void     chip8_stack_push(chip8* c) { c->stack[c->sp++] = chip8_pc_get(c); }
-static inline void     chip8_stack_pop(chip8* c) { chip8_pc_set(c, c->stack[--c->sp]); }
+static inline void     chip8_stack_push(chip8* c) {
+    c->stack[c->sp] = chip8_pc_get(c);
+    c->hash ^= chip8_hash_key(HASH_STACK + c->sp, c->stack[c->sp]);
+    c->sp++;
+}
+static inline void     chip8_stack_pop(chip8* c) {
+    c->sp--;
+    c->hash ^= chip8_hash_key(HASH_STACK + c->sp, c->stack[c->sp]);
+    chip8_pc_set(c, c->stack[c->sp]);
+}
+
+static inline void     chip8_gfx_flip(chip8* c, uint16_t pos) {
+    c->gfx[pos] ^= 1;
+    c->hash ^= chip8_hash_key(HASH_GFX + pos, 1);
+}
+
+/*
+ * hash of the whole machine state except the key states, O(1) since
+ * only the few small registers are mixed in on top of c->hash
+ * */
+static inline uint64_t chip8_state_hash(chip8* c) {
+    return c->hash
+        ^ chip8_hash_mix((uint64_t)c->pc | (uint64_t)c->I << 12 | (uint64_t)c->sp << 24
+                         | (uint64_t)c->delay_timer << 32 | (uint64_t)c->sound_timer << 40)
+        ^ chip8_hash_mix((uint64_t)1 << 48 | c->rng);
+}
+
+static inline uint8_t  chip8_rand(chip8* c) {
+    uint32_t x = c->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    c->rng = x;
+    return x;
+}
 
 static inline void     chip8_key_set(chip8* c, uint8_t key, uint8_t val) { c->keys[key & 0xF] = val; }
 static inline uint8_t  chip8_key_get(chip8* c, uint8_t key) { return c->keys[key & 0xF]; }
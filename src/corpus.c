@@ -0,0 +1,295 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "corpus.h"
+#include "analyze.h"
+
+#define CORPUS_ALIGN 64
+#define MAX_ROM_SIZE (MEM_SIZE - PROGRAM_START)
+
+static uint8_t header_valid(const corpus_header* h) {
+    return h->magic == CORPUS_MAGIC && h->version == CORPUS_VERSION;
+}
+
+/*
+ * opens an archive for appending, or creates it. the entries of the
+ * current index are kept in memory and written out again on close.
+ * returns NULL if the archive is invalid or cannot be read, written
+ * or held in memory
+ * */
+corpus_writer* corpus_writer_open(const char* path) {
+    corpus_header h = { .magic = CORPUS_MAGIC, .version = CORPUS_VERSION };
+    FILE* f = fopen(path, "r+b");
+
+    if (f == NULL) {
+        f = fopen(path, "w+b");
+        if (f == NULL)
+            return NULL;
+        h.index_offset = sizeof(corpus_header);
+        if (fwrite(&h, sizeof(h), 1, f) != 1) {
+            fclose(f);
+            return NULL;
+        }
+    } else if (fread(&h, sizeof(h), 1, f) != 1 || !header_valid(&h)) {
+        fclose(f);
+        return NULL;
+    }
+
+    corpus_writer* w = calloc(1, sizeof(corpus_writer));
+    if (w == NULL) {
+        fclose(f);
+        return NULL;
+    }
+    w->f = f;
+    w->num_entries = h.num_entries;
+    w->max_entries = h.num_entries > 1024 ? h.num_entries : 1024;
+    w->entries = malloc(w->max_entries * sizeof(corpus_entry));
+    w->seen = state_set_init(w->max_entries);
+    w->c = chip8_init();
+
+    if (w->entries == NULL || w->seen == NULL || w->c == NULL
+        || fseek(f, h.index_offset, SEEK_SET) != 0
+        || fread(w->entries, sizeof(corpus_entry), h.num_entries, f) != h.num_entries) {
+        fclose(f);
+        w->f = NULL;
+        corpus_writer_close(w);
+        return NULL;
+    }
+    for (uint64_t i=0; i<w->num_entries; i++) {
+        if (state_set_insert(w->seen, w->entries[i].hash) < 0) {
+            fclose(f);
+            w->f = NULL;
+            corpus_writer_close(w);
+            return NULL;
+        }
+    }
+
+    /* new roms go after everything, the old index stays valid until close */
+    fseek(f, 0, SEEK_END);
+    w->offset = ftell(f);
+    return w;
+}
+
+/*
+ * appends a rom unless one with the same hash is already in the archive,
+ * returns 1 if it was added, 0 for a duplicate, CORPUS_INVALID if it can
+ * not be loaded at all and CORPUS_FAILED if it could not be written or
+ * held in memory. after a failure corpus_writer_close fails and keeps
+ * the previous index
+ * */
+int8_t corpus_writer_add(corpus_writer* w, const uint8_t* data, size_t size, uint8_t quirks) {
+    if (size == 0 || size > MAX_ROM_SIZE)
+        return CORPUS_INVALID;
+
+    uint64_t hash = chip8_rom_hash(data, size);
+    if (state_set_contains(w->seen, hash))
+        return 0;
+
+    chip8_reset(w->c);
+    chip8_program_load_mem(w->c, data, size);
+    int8_t variant = corpus_variant(w->c, w->cache_dir);
+    if (variant < 0) {
+        w->failed = 1;
+        return CORPUS_FAILED;
+    }
+
+    if (w->num_entries == w->max_entries) {
+        corpus_entry* entries = realloc(w->entries, w->max_entries * 2 * sizeof(corpus_entry));
+        if (entries == NULL) {
+            w->failed = 1;
+            return CORPUS_FAILED;
+        }
+        w->entries = entries;
+        w->max_entries *= 2;
+    }
+
+    if (fwrite(data, 1, size, w->f) != size || state_set_insert(w->seen, hash) < 0) {
+        w->failed = 1;
+        return CORPUS_FAILED;
+    }
+
+    corpus_entry* e = &w->entries[w->num_entries++];
+    memset(e, 0, sizeof(corpus_entry));
+    e->hash = hash;
+    e->offset = w->offset;
+    e->size = size;
+    e->variant = variant;
+    e->quirks = quirks;
+    w->offset += size;
+    return 1;
+}
+
+static int entry_cmp(const void* a, const void* b) {
+    uint64_t x = ((const corpus_entry*)a)->hash;
+    uint64_t y = ((const corpus_entry*)b)->hash;
+    return (x > y) - (x < y);
+}
+
+/*
+ * writes the sorted index after the roms and only then the header that
+ * points to it, so an interrupted or failed ingest leaves the previous
+ * index in use. returns 0 on success
+ * */
+uint8_t corpus_writer_close(corpus_writer* w) {
+    uint8_t failed = w->f == NULL || w->failed;
+
+    if (w->f != NULL && w->failed) {
+        fclose(w->f);
+    } else if (w->f != NULL) {
+        static const uint8_t zero[CORPUS_ALIGN];
+        uint64_t pad = (CORPUS_ALIGN - w->offset % CORPUS_ALIGN) % CORPUS_ALIGN;
+        fwrite(zero, 1, pad, w->f);
+
+        corpus_header h = {
+            .magic = CORPUS_MAGIC,
+            .version = CORPUS_VERSION,
+            .num_entries = w->num_entries,
+            .index_offset = w->offset + pad,
+        };
+        qsort(w->entries, w->num_entries, sizeof(corpus_entry), entry_cmp);
+        failed |= fwrite(w->entries, sizeof(corpus_entry), w->num_entries, w->f) != w->num_entries;
+        failed |= fflush(w->f) != 0 || fsync(fileno(w->f)) != 0;
+
+        if (!failed) {
+            fseek(w->f, 0, SEEK_SET);
+            failed |= fwrite(&h, sizeof(h), 1, w->f) != 1;
+            failed |= fflush(w->f) != 0 || fsync(fileno(w->f)) != 0;
+        }
+        failed |= fclose(w->f) != 0;
+    }
+
+    if (w->c != NULL)
+        chip8_free(w->c);
+    if (w->seen != NULL)
+        state_set_free(w->seen);
+    free(w->entries);
+    free(w);
+    return failed;
+}
+
+/*
+ * maps an archive, with writable set results can be stored in the
+ * entries and are written back on close
+ * */
+corpus* corpus_open(const char* path, uint8_t writable) {
+    int fd = open(path, writable ? O_RDWR : O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(corpus_header)) {
+        close(fd);
+        return NULL;
+    }
+    uint8_t* base = mmap(NULL, st.st_size, PROT_READ | (writable ? PROT_WRITE : 0),
+                         MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+
+    corpus* cp = malloc(sizeof(corpus));
+    cp->fd = fd;
+    cp->base = base;
+    cp->size = st.st_size;
+    cp->writable = writable;
+    cp->header = (corpus_header*)base;
+    cp->entries = (corpus_entry*)(base + cp->header->index_offset);
+
+    /* every rom has to lie inside the file before anything trusts the index */
+    corpus_header* h = cp->header;
+    uint8_t valid = header_valid(h)
+        && h->index_offset % CORPUS_ALIGN == 0
+        && h->index_offset <= cp->size
+        && h->num_entries <= (cp->size - h->index_offset) / sizeof(corpus_entry);
+    for (uint64_t i=0; valid && i<h->num_entries; i++) {
+        corpus_entry* e = &cp->entries[i];
+        valid = e->size <= MAX_ROM_SIZE && e->variant <= VARIANT_XOCHIP
+             && e->offset >= sizeof(corpus_header)
+             && e->offset <= cp->size && e->size <= cp->size - e->offset;
+    }
+    if (!valid) {
+        corpus_close(cp);
+        return NULL;
+    }
+
+    madvise(base, cp->size, MADV_WILLNEED);
+    return cp;
+}
+
+void corpus_close(corpus* cp) {
+    if (cp->writable)
+        msync(cp->base, cp->size, MS_SYNC);
+    munmap(cp->base, cp->size);
+    close(cp->fd);
+    free(cp);
+}
+
+/*
+ * returns the entry of the rom with the given hash, the index is
+ * sorted by hash
+ * */
+corpus_entry* corpus_find(corpus* cp, uint64_t hash) {
+    uint64_t lo = 0, hi = corpus_count(cp);
+    while (lo < hi) {
+        uint64_t mid = (lo + hi) / 2;
+        if (cp->entries[mid].hash < hash)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return (lo < corpus_count(cp) && cp->entries[lo].hash == hash) ? &cp->entries[lo] : NULL;
+}
+
+/* opcodes that only exist in the extensions */
+static uint8_t variant_of(uint16_t op) {
+    uint8_t kk = op & 0xFF;
+    uint8_t n = op & 0xF;
+    switch (op >> 12) {
+        case 0x0:
+            if ((op & 0xFFF0) == 0x00D0) return VARIANT_XOCHIP;   /* scroll up */
+            if ((op & 0xFFF0) == 0x00C0 || op >= 0x00FB) return VARIANT_SCHIP;
+            break;
+        case 0x5:
+            if (n == 0x2 || n == 0x3) return VARIANT_XOCHIP;      /* save/load range */
+            break;
+        case 0xD:
+            if (n == 0x0) return VARIANT_SCHIP;                    /* 16x16 sprite */
+            break;
+        case 0xF:
+            if (op == 0xF000 || op == 0xF002 || kk == 0x01 || kk == 0x3A) return VARIANT_XOCHIP;
+            if (kk == 0x30 || kk == 0x75 || kk == 0x85) return VARIANT_SCHIP;
+            break;
+    }
+    return VARIANT_CHIP8;
+}
+
+/*
+ * guesses the instruction set of the loaded rom from the extension
+ * opcodes in its reachable code. the interpreter halts on the first
+ * one, which ends the block, so a rom is classified by what it runs
+ * before it would halt. the analysis is cached in cache_dir unless it
+ * is NULL. returns -1 if the rom cannot be analysed
+ * */
+int8_t corpus_variant(chip8* c, const char* cache_dir) {
+    analysis* a = chip8_analyze_cached(c, cache_dir);
+    if (a == NULL)
+        return -1;
+    int8_t variant = VARIANT_CHIP8;
+    for (uint16_t i=0; i<a->num_blocks; i++) {
+        block* b = &a->blocks[i];
+        for (uint16_t addr=b->start; addr!=(b->end & MEM_MASK); addr=(addr + 2) & MEM_MASK) {
+            uint16_t op = c->memory[addr] << 8 | c->memory[(addr + 1) & MEM_MASK];
+            int8_t v = variant_of(op);
+            if (v > variant)
+                variant = v;
+        }
+    }
+    analysis_free(a);
+    return variant;
+}
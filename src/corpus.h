@@ -0,0 +1,111 @@
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "chip8.h"
+#include "state.h"
+
+#define CORPUS_MAGIC   0x4B503843 /* "C8PK" */
+#define CORPUS_VERSION 1
+
+/* corpus_writer_add results besides added (1) and duplicate (0) */
+#define CORPUS_INVALID -1   /* empty or does not fit in memory */
+#define CORPUS_FAILED  -2   /* could not be written or held in memory */
+
+/* instruction set a rom was written for, see corpus_variant */
+#define VARIANT_CHIP8  0
+#define VARIANT_SCHIP  1
+#define VARIANT_XOCHIP 2
+
+/*
+ * packed rom archive
+ *
+ * a header, the rom images back to back and an index of fixed size
+ * entries sorted by chip8_rom_hash. the archive is read through mmap,
+ * so iterating over the roms costs no system calls, and the results
+ * of the last run are stored in the index in place. roms are only
+ * ever appended: a new ingest writes its roms and a new index after
+ * the old one and then points the header at it
+ * */
+struct corpus_header_t {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t num_entries;
+    uint64_t index_offset;
+    uint8_t  reserved[40];
+};
+typedef struct corpus_header_t corpus_header;
+
+/*
+ * key identifies the settings of the run that produced the result: the
+ * interpreter and archive versions, the cycle budget and the quirks of
+ * the entry. a rom whose key matches the current settings does not need
+ * to run again
+ * */
+struct corpus_result_t {
+    uint64_t key;             /* 0 if the rom never ran */
+    uint64_t state_hash;      /* chip8_state_hash at the end */
+    uint64_t cycles;
+    uint8_t  err;             /* ERR_* if it halted on an error */
+    uint8_t  halted;
+    uint8_t  reserved[6];
+};
+typedef struct corpus_result_t corpus_result;
+
+struct corpus_entry_t {
+    uint64_t hash;            /* chip8_rom_hash */
+    uint64_t offset;
+    uint32_t size;
+    uint8_t  variant;
+    uint8_t  quirks;
+    uint8_t  reserved[2];
+    corpus_result result;
+    uint8_t  pad[8];
+};
+typedef struct corpus_entry_t corpus_entry;
+
+_Static_assert(sizeof(corpus_header) == 64, "corpus header must be 64 bytes");
+_Static_assert(sizeof(corpus_entry) == 64, "corpus entries must be one cache line");
+
+struct corpus_t {
+    int            fd;
+    uint8_t*       base;      /* the mapped archive */
+    size_t         size;
+    uint8_t        writable;
+    corpus_header* header;
+    corpus_entry*  entries;
+};
+typedef struct corpus_t corpus;
+
+/*
+ * streaming ingester, roms are deduplicated by hash against the archive
+ * being appended to and everything added since
+ * */
+struct corpus_writer_t {
+    FILE*         f;
+    corpus_entry* entries;
+    uint64_t      num_entries, max_entries;
+    uint64_t      offset;     /* where the next rom goes */
+    state_set*    seen;
+    chip8*        c;          /* for variant detection */
+    const char*   cache_dir;  /* analyses of known roms, NULL for none */
+    uint8_t       failed;     /* an add failed, close keeps the old index */
+};
+typedef struct corpus_writer_t corpus_writer;
+
+corpus_writer* corpus_writer_open(const char* path);
+int8_t         corpus_writer_add(corpus_writer* w, const uint8_t* data, size_t size, uint8_t quirks);
+uint8_t        corpus_writer_close(corpus_writer* w);
+
+corpus*        corpus_open(const char* path, uint8_t writable);
+void           corpus_close(corpus* cp);
+corpus_entry*  corpus_find(corpus* cp, uint64_t hash);
+
+int8_t         corpus_variant(chip8* c, const char* cache_dir);
+
+static inline uint64_t corpus_count(corpus* cp) { return cp->header->num_entries; }
+static inline const uint8_t* corpus_rom(corpus* cp, corpus_entry* e) { return cp->base + e->offset; }
+
+#endif
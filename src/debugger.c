@@ -0,0 +1,354 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include "debugger.h"
+#include "disasm.h"
+#include "metrics.h"
+
+#define BIT_GET(map, a)   (((map)[(a) >> 6] >> ((a) & 63)) & 1)
+#define BIT_SET(map, a)   ((map)[(a) >> 6] |= 1ULL << ((a) & 63))
+#define BIT_CLEAR(map, a) ((map)[(a) >> 6] &= ~(1ULL << ((a) & 63)))
+
+/*
+ * one predicate per operator and operand width,
+ * the operand is read at a fixed offset into struct chip8_t
+ * */
+#define DEFINE_CONDITION(name, type, op) \
+    static uint8_t name(chip8* c, const condition* cond) { \
+        return *(const type*)((const uint8_t*)c + cond->offset) op (type)cond->value; \
+    }
+
+DEFINE_CONDITION(cond_eq8,  uint8_t,  ==)
+DEFINE_CONDITION(cond_ne8,  uint8_t,  !=)
+DEFINE_CONDITION(cond_lt8,  uint8_t,  <)
+DEFINE_CONDITION(cond_le8,  uint8_t,  <=)
+DEFINE_CONDITION(cond_gt8,  uint8_t,  >)
+DEFINE_CONDITION(cond_ge8,  uint8_t,  >=)
+DEFINE_CONDITION(cond_eq16, uint16_t, ==)
+DEFINE_CONDITION(cond_ne16, uint16_t, !=)
+DEFINE_CONDITION(cond_lt16, uint16_t, <)
+DEFINE_CONDITION(cond_le16, uint16_t, <=)
+DEFINE_CONDITION(cond_gt16, uint16_t, >)
+DEFINE_CONDITION(cond_ge16, uint16_t, >=)
+
+static const struct {
+    const char*    op;
+    condition_func pred8, pred16;
+} condition_ops[] = {
+    /* two character operators first so "<=" is not taken as "<" */
+    { "==", cond_eq8, cond_eq16 },
+    { "!=", cond_ne8, cond_ne16 },
+    { "<=", cond_le8, cond_le16 },
+    { ">=", cond_ge8, cond_ge16 },
+    { "<",  cond_lt8, cond_lt16 },
+    { ">",  cond_gt8, cond_gt16 },
+};
+
+debugger* debugger_init(FILE* in, FILE* out) {
+    debugger* d = calloc(1, sizeof(debugger));
+    d->in = in;
+    d->out = out;
+    d->finish_sp = -1;
+    return d;
+}
+
+void debugger_free(debugger* d) {
+    free(d);
+}
+
+static void debugger_active_update(debugger* d) {
+    for (uint8_t i=0; i<MEM_SIZE/64; i++)
+        d->active[i] = d->user[i] | d->temp[i];
+}
+
+static void debugger_temp_clear(debugger* d) {
+    memset(d->temp, 0, sizeof(d->temp));
+    d->finish_sp = -1;
+    debugger_active_update(d);
+}
+
+static void debugger_temp_set(debugger* d, uint16_t addr) {
+    BIT_SET(d->temp, addr & MEM_MASK);
+    BIT_SET(d->active, addr & MEM_MASK);
+}
+
+/*
+ * compiles an expression like "VF==1", "I>=0x300" or "DT!=0",
+ * returns 0 if the expression is invalid
+ * */
+uint8_t debugger_condition_compile(condition* cond, const char* expr) {
+    char lhs[4];
+    size_t n = 0;
+    while (*expr == ' ') expr++;
+    while (n < sizeof(lhs) - 1 && *expr && strchr("=!<> ", *expr) == NULL)
+        lhs[n++] = *expr++;
+    lhs[n] = '\0';
+    while (*expr == ' ') expr++;
+
+    uint8_t wide = 0;
+    if (n == 2 && (lhs[0] == 'V' || lhs[0] == 'v') && strchr("0123456789abcdefABCDEF", lhs[1])) {
+        cond->offset = offsetof(chip8, V) + strtoul(lhs + 1, NULL, 16);
+    } else if (strcasecmp(lhs, "I") == 0) {
+        cond->offset = offsetof(chip8, I); wide = 1;
+    } else if (strcasecmp(lhs, "PC") == 0) {
+        cond->offset = offsetof(chip8, pc); wide = 1;
+    } else if (strcasecmp(lhs, "SP") == 0) {
+        cond->offset = offsetof(chip8, sp);
+    } else if (strcasecmp(lhs, "DT") == 0) {
+        cond->offset = offsetof(chip8, delay_timer);
+    } else if (strcasecmp(lhs, "ST") == 0) {
+        cond->offset = offsetof(chip8, sound_timer);
+    } else {
+        return 0;
+    }
+
+    cond->pred = NULL;
+    for (uint8_t i=0; i<sizeof(condition_ops)/sizeof(condition_ops[0]); i++) {
+        size_t len = strlen(condition_ops[i].op);
+        if (strncmp(expr, condition_ops[i].op, len) == 0) {
+            cond->pred = wide ? condition_ops[i].pred16 : condition_ops[i].pred8;
+            expr += len;
+            break;
+        }
+    }
+    if (cond->pred == NULL)
+        return 0;
+
+    char* end;
+    cond->value = strtoul(expr, &end, 0);
+    while (*end == ' ' || *end == '\n') end++;
+    return end != expr && *end == '\0';
+}
+
+static void debugger_conditions_remove(debugger* d, uint16_t addr) {
+    uint8_t j = 0;
+    for (uint8_t i=0; i<d->num_conditions; i++) {
+        if (d->conditions[i].addr != addr)
+            d->conditions[j++] = d->conditions[i];
+    }
+    d->num_conditions = j;
+}
+
+/*
+ * sets a breakpoint, with an optional condition that has to hold
+ * for execution to stop. without one any condition already set at
+ * addr is dropped. returns 0 if the condition is invalid
+ * */
+uint8_t debugger_break_set(debugger* d, uint16_t addr, const char* cond) {
+    addr &= MEM_MASK;
+    if (cond == NULL) {
+        debugger_conditions_remove(d, addr);
+    } else {
+        if (d->num_conditions == MAX_CONDITIONS)
+            return 0;
+        condition* cd = &d->conditions[d->num_conditions];
+        if (!debugger_condition_compile(cd, cond))
+            return 0;
+        cd->addr = addr;
+        d->num_conditions++;
+    }
+    BIT_SET(d->user, addr);
+    debugger_active_update(d);
+    return 1;
+}
+
+void debugger_break_clear(debugger* d, uint16_t addr) {
+    addr &= MEM_MASK;
+    debugger_conditions_remove(d, addr);
+    BIT_CLEAR(d->user, addr);
+    debugger_active_update(d);
+}
+
+/*
+ * slow path of debugger_check, only reached when pc has a breakpoint
+ * */
+uint8_t debugger_hit(debugger* d, chip8* c) {
+    uint16_t pc = chip8_pc_get(c);
+
+    if (BIT_GET(d->temp, pc) && (d->finish_sp < 0 || c->sp < d->finish_sp)) {
+        debugger_temp_clear(d);
+        return 1;
+    }
+    if (!BIT_GET(d->user, pc))
+        return 0;
+
+    uint8_t conditional = 0;
+    for (uint8_t i=0; i<d->num_conditions; i++) {
+        const condition* cond = &d->conditions[i];
+        if (cond->addr != pc)
+            continue;
+        if (cond->pred(c, cond))
+            return 1;
+        conditional = 1;
+    }
+    return !conditional;
+}
+
+/*
+ * the debugger reads code without the accessors, like
+ * debugger_print_mem, so showing it does not fire read watchpoints
+ * */
+static uint16_t debugger_code_at(chip8* c, uint16_t addr) {
+    return c->memory[addr & MEM_MASK] << 8 | c->memory[(addr + 1) & MEM_MASK];
+}
+
+static void debugger_print_location(debugger* d, chip8* c) {
+    char buf[32];
+    uint16_t pc = chip8_pc_get(c);
+    chip8_disasm(debugger_code_at(c, pc), buf, sizeof(buf));
+    fprintf(d->out, "0x%03X: %s\n", pc, buf);
+}
+
+static void debugger_print_regs(debugger* d, chip8* c) {
+    fprintf(d->out, "pc 0x%03X  I 0x%03X  sp 0x%02X  DT 0x%02X  ST 0x%02X\n",
+            c->pc, c->I, c->sp, c->delay_timer, c->sound_timer);
+    for (uint8_t i=0; i<NUM_REGS; i++)
+        fprintf(d->out, "V%X 0x%02X%s", i, chip8_reg_get(c,i), (i % 8 == 7) ? "\n" : "  ");
+    fprintf(d->out, "stack ");
+    for (uint8_t i=0; i<c->sp && i<STACK_SIZE; i++)
+        fprintf(d->out, "0x%03X ", c->stack[i]);
+    fprintf(d->out, "\n");
+}
+
+static void debugger_print_mem(debugger* d, chip8* c, uint16_t addr, uint16_t len) {
+    for (uint16_t i=0; i<len; i++) {
+        if (i % 16 == 0)
+            fprintf(d->out, "%s0x%03X:", i ? "\n" : "", (addr + i) & MEM_MASK);
+        fprintf(d->out, " %02X", c->memory[(addr + i) & MEM_MASK]);
+    }
+    fprintf(d->out, "\n");
+}
+
+static void debugger_print_disasm(debugger* d, chip8* c, uint16_t addr, uint16_t count) {
+    char buf[32];
+    for (uint16_t i=0; i<count; i++, addr = (addr + 2) & MEM_MASK) {
+        chip8_disasm(debugger_code_at(c, addr), buf, sizeof(buf));
+        fprintf(d->out, "%c%c 0x%03X: %s\n",
+                addr == chip8_pc_get(c) ? '>' : ' ',
+                BIT_GET(d->user, addr) ? '*' : ' ', addr, buf);
+    }
+}
+
+static void debugger_print_help(debugger* d) {
+    fprintf(d->out,
+            "break ADDR [COND]  set breakpoint, e.g. \"break 2a4 VF==1\"\n"
+            "delete ADDR        remove breakpoint\n"
+            "info               list breakpoints\n"
+            "continue           run until the next breakpoint\n"
+            "step [N]           execute N instructions\n"
+            "next               step over subroutine calls\n"
+            "finish             run until the current subroutine returns\n"
+            "regs               show registers\n"
+            "mem ADDR [LEN]     show memory\n"
+            "disas [ADDR] [N]   disassemble N instructions\n"
+            "quit               halt the program\n");
+}
+
+/*
+ * interactive prompt, returns when execution should resume.
+ * returns 1 if the user asked to quit
+ * */
+uint8_t debugger_prompt(debugger* d, chip8* c) {
+    char line[128];
+
+    debugger_print_location(d, c);
+
+    while (1) {
+        fprintf(d->out, "(c8db) ");
+        fflush(d->out);
+        if (fgets(line, sizeof(line), d->in) == NULL)
+            return 1;
+
+        /* an empty line repeats the last command */
+        if (line[0] == '\n')
+            strcpy(line, d->last_command);
+        else
+            snprintf(d->last_command, sizeof(d->last_command), "%s", line);
+
+        char* cmd = strtok(line, " \t\n");
+        char* arg1 = strtok(NULL, " \t\n");
+        char* arg2 = strtok(NULL, "\n");
+        if (cmd == NULL)
+            continue;
+
+        if (!strcmp(cmd, "b") || !strcmp(cmd, "break")) {
+            uint16_t addr = arg1 ? strtoul(arg1, NULL, 16) : chip8_pc_get(c);
+            if (!debugger_break_set(d, addr, arg2))
+                fprintf(d->out, "invalid condition \"%s\"\n", arg2);
+
+        } else if (!strcmp(cmd, "d") || !strcmp(cmd, "delete")) {
+            if (arg1)
+                debugger_break_clear(d, strtoul(arg1, NULL, 16));
+
+        } else if (!strcmp(cmd, "i") || !strcmp(cmd, "info")) {
+            for (uint16_t a=0; a<MEM_SIZE; a++) {
+                if (!BIT_GET(d->user, a))
+                    continue;
+                fprintf(d->out, "0x%03X", a);
+                for (uint8_t i=0; i<d->num_conditions; i++)
+                    if (d->conditions[i].addr == a)
+                        fprintf(d->out, " [conditional]");
+                fprintf(d->out, "\n");
+            }
+
+        } else if (!strcmp(cmd, "c") || !strcmp(cmd, "continue")) {
+            return 0;
+
+        } else if (!strcmp(cmd, "s") || !strcmp(cmd, "step")) {
+            long n = arg1 ? strtol(arg1, NULL, 10) : 1;
+            while (n-- > 0 && !chip8_check_flag(c, HALT))
+                chip8_emulate_cycle(c);
+            if (chip8_check_flag(c, HALT)) {
+                char reason[64];
+                fprintf(d->out, "halted: %s\n", chip8_strerror(c, reason, sizeof(reason)));
+            }
+            debugger_print_location(d, c);
+
+        } else if (!strcmp(cmd, "n") || !strcmp(cmd, "next")) {
+            uint16_t pc = chip8_pc_get(c);
+            if ((debugger_code_at(c, pc) & 0xF000) == 0x2000) {
+                debugger_temp_set(d, pc + 2);
+                return 0;
+            }
+            chip8_emulate_cycle(c);
+            debugger_print_location(d, c);
+
+        } else if (!strcmp(cmd, "f") || !strcmp(cmd, "finish")) {
+            if (c->sp == 0) {
+                fprintf(d->out, "not in a subroutine\n");
+                continue;
+            }
+            /* the stack holds the CALL, execution resumes after it */
+            debugger_temp_set(d, c->stack[c->sp - 1] + 2);
+            d->finish_sp = c->sp;
+            return 0;
+
+        } else if (!strcmp(cmd, "r") || !strcmp(cmd, "regs")) {
+            debugger_print_regs(d, c);
+
+        } else if (!strcmp(cmd, "x") || !strcmp(cmd, "mem")) {
+            uint16_t addr = arg1 ? strtoul(arg1, NULL, 16) : chip8_index_get(c);
+            uint16_t len = arg2 ? strtoul(arg2, NULL, 10) : 16;
+            debugger_print_mem(d, c, addr, len);
+
+        } else if (!strcmp(cmd, "l") || !strcmp(cmd, "disas")) {
+            uint16_t addr = arg1 ? strtoul(arg1, NULL, 16) : chip8_pc_get(c);
+            uint16_t count = arg2 ? strtoul(arg2, NULL, 10) : 10;
+            debugger_print_disasm(d, c, addr, count);
+
+        } else if (!strcmp(cmd, "q") || !strcmp(cmd, "quit")) {
+            c->flags |= HALT;
+            counter_add(&c->counters->halts, 1);
+            return 1;
+
+        } else if (!strcmp(cmd, "h") || !strcmp(cmd, "help")) {
+            debugger_print_help(d);
+
+        } else {
+            fprintf(d->out, "unknown command \"%s\", try help\n", cmd);
+        }
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef DEBUGGER_H
+#define DEBUGGER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "chip8.h"
+
+#define MAX_CONDITIONS 32
+
+struct condition_t;
+typedef uint8_t (*condition_func)(chip8* c, const struct condition_t* cond);
+
+/*
+ * a breakpoint condition such as "VF==1", compiled into a predicate
+ * specialised for the operator and operand width plus the offset of
+ * the operand inside struct chip8_t
+ * */
+struct condition_t {
+    condition_func pred;
+    uint16_t       addr;
+    uint16_t       offset;
+    uint16_t       value;
+};
+typedef struct condition_t condition;
+
+/*
+ * breakpoints are kept in a 4096-bit bitmap, so checking the current
+ * pc is one load and a mask. the active bitmap is the union of the
+ * user breakpoints and temporary ones set by next/finish
+ * */
+struct debugger_t {
+    uint64_t  active[MEM_SIZE / 64];
+    uint64_t  user[MEM_SIZE / 64];
+    uint64_t  temp[MEM_SIZE / 64];
+
+    condition conditions[MAX_CONDITIONS];
+    uint8_t   num_conditions;
+    int16_t   finish_sp;
+
+    FILE*     in;
+    FILE*     out;
+    char      last_command[128];
+};
+typedef struct debugger_t debugger;
+
+debugger* debugger_init(FILE* in, FILE* out);
+void      debugger_free(debugger* d);
+uint8_t   debugger_break_set(debugger* d, uint16_t addr, const char* cond);
+void      debugger_break_clear(debugger* d, uint16_t addr);
+uint8_t   debugger_condition_compile(condition* cond, const char* expr);
+uint8_t   debugger_hit(debugger* d, chip8* c);
+uint8_t   debugger_prompt(debugger* d, chip8* c);
+
+/*
+ * returns nonzero if execution should stop before the instruction at pc
+ * */
+static inline uint8_t debugger_check(debugger* d, chip8* c) {
+    uint16_t pc = chip8_pc_get(c);
+    if (((d->active[pc >> 6] >> (pc & 63)) & 1) == 0)
+        return 0;
+    return debugger_hit(d, c);
+}
+
+#endif
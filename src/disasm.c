@@ -0,0 +1,84 @@
+#include <stdint.h>
+#include <stdio.h>
+#include "chip8.h"
+#include "disasm.h"
+
+#define X    ((opcode & 0x0F00) >> 8)
+#define Y    ((opcode & 0x00F0) >> 4)
+#define N    (opcode & 0x000F)
+#define KK   (opcode & 0x00FF)
+#define ADDR (opcode & 0x0FFF)
+
+static const char* alu_names[16] = {
+    "LD",  "AND", "OR",  "XOR", "ADD", "SUB", "SHR", "SUBN",
+    NULL,  NULL,  NULL,  NULL,  NULL,  NULL,  "SHL", NULL
+};
+
+/*
+ * writes the assembly for opcode into buf,
+ * returns 1 if it is a valid instruction
+ * */
+uint8_t chip8_disasm(uint16_t opcode, char* buf, size_t len) {
+    switch (opcode >> 12) {
+        case 0x0:
+            if (opcode == 0x00E0) { snprintf(buf, len, "CLS"); return 1; }
+            if (opcode == 0x00EE) { snprintf(buf, len, "RET"); return 1; }
+            snprintf(buf, len, "SYS 0x%03X", ADDR);
+            return 1;
+        case 0x1: snprintf(buf, len, "JMP 0x%03X", ADDR); return 1;
+        case 0x2: snprintf(buf, len, "CALL 0x%03X", ADDR); return 1;
+        case 0x3: snprintf(buf, len, "SEQ V%X 0x%02X", X, KK); return 1;
+        case 0x4: snprintf(buf, len, "SNE V%X 0x%02X", X, KK); return 1;
+        case 0x5:
+            if (N != 0) break;
+            snprintf(buf, len, "SEQ V%X V%X", X, Y);
+            return 1;
+        case 0x6: snprintf(buf, len, "LD V%X 0x%02X", X, KK); return 1;
+        case 0x7: snprintf(buf, len, "ADD V%X 0x%02X", X, KK); return 1;
+        case 0x8:
+            if (alu_names[N] == NULL) break;
+            snprintf(buf, len, "%s V%X V%X", alu_names[N], X, Y);
+            return 1;
+        case 0x9:
+            if (N != 0) break;
+            snprintf(buf, len, "SNE V%X V%X", X, Y);
+            return 1;
+        case 0xA: snprintf(buf, len, "LD I 0x%03X", ADDR); return 1;
+        case 0xB: snprintf(buf, len, "JMP V0 0x%03X", ADDR); return 1;
+        case 0xC: snprintf(buf, len, "RND V%X 0x%02X", X, KK); return 1;
+        case 0xD: snprintf(buf, len, "DRAW V%X V%X 0x%X", X, Y, N); return 1;
+        case 0xE:
+            if (KK == 0x9E) { snprintf(buf, len, "SKP V%X", X); return 1; }
+            if (KK == 0xA1) { snprintf(buf, len, "SKNP V%X", X); return 1; }
+            break;
+        case 0xF:
+            switch (KK) {
+                case 0x07: snprintf(buf, len, "LD V%X DT", X); return 1;
+                case 0x0A: snprintf(buf, len, "LD K V%X", X); return 1;
+                case 0x15: snprintf(buf, len, "LD DT V%X", X); return 1;
+                case 0x18: snprintf(buf, len, "LD ST V%X", X); return 1;
+                case 0x1E: snprintf(buf, len, "ADD I V%X", X); return 1;
+                case 0x29: snprintf(buf, len, "LD F V%X", X); return 1;
+                case 0x33: snprintf(buf, len, "LD B V%X", X); return 1;
+                case 0x55: snprintf(buf, len, "LD [I] V%X", X); return 1;
+                case 0x65: snprintf(buf, len, "LD V%X [I]", X); return 1;
+            }
+            break;
+    }
+    snprintf(buf, len, "DW 0x%04X", opcode);
+    return 0;
+}
+
+/*
+ * writes a listing of a rom that chip8_asm turns back into the same bytes
+ * */
+void chip8_disasm_rom(const uint8_t* rom, size_t size, FILE* out) {
+    char buf[32];
+    size_t i;
+    for (i=0; i+1<size; i+=2) {
+        chip8_disasm(rom[i] << 8 | rom[i+1], buf, sizeof(buf));
+        fprintf(out, "%-16s ; 0x%03zX\n", buf, PROGRAM_START + i);
+    }
+    if (i < size)
+        fprintf(out, "DB 0x%02X\n", rom[i]);
+}
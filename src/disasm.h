@@ -0,0 +1,15 @@
+#ifndef DISASM_H
+#define DISASM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+ * disassembler using the mnemonics and operand syntax of assemble.py,
+ * words that are not valid instructions are shown as DW 0xNNNN
+ * */
+uint8_t chip8_disasm(uint16_t opcode, char* buf, size_t len);
+void    chip8_disasm_rom(const uint8_t* rom, size_t size, FILE* out);
+
+#endif
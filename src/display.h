@@ -9,7 +9,7 @@
 struct display_t {
     SDL_Surface* screen;
     uint8_t width, height;
-} display_t;
+};
 
 typedef struct display_t display;
 
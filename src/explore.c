@@ -0,0 +1,563 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include "explore.h"
+
+/* packed machine state, the unit that deltas are taken over */
+#define IMG_MEM    0
+#define IMG_V      (IMG_MEM + MEM_SIZE)
+#define IMG_GFX    (IMG_V + NUM_REGS)
+#define IMG_STACK  (IMG_GFX + WIDTH * HEIGHT)
+#define IMG_REGS   (IMG_STACK + STACK_SIZE * 2)
+#define IMG_SIZE   (IMG_REGS + 20)
+
+#define ARENA_CHUNK (1 << 20)
+#define MAX_WORKERS 64
+
+struct arena_chunk_t {
+    struct arena_chunk_t* next;
+    size_t used;
+    uint8_t data[];
+};
+
+struct frontier_entry_t {
+    int64_t prio;
+    explore_node* node;
+};
+typedef struct frontier_entry_t frontier_entry;
+
+/* binary min-heap on prio, owned by one worker but open to stealing */
+struct frontier_t {
+    pthread_mutex_t lock;
+    frontier_entry* heap;
+    uint32_t size, cap;
+};
+typedef struct frontier_t frontier;
+
+struct worker_t {
+    struct explore_t* e;
+    uint32_t id;
+    pthread_t thread;
+    chip8* c;
+    uint8_t image[IMG_SIZE];        /* state being expanded */
+    uint8_t child[IMG_SIZE];
+    uint8_t delta[2 * IMG_SIZE];
+    struct arena_chunk_t* arena;
+    frontier front;
+    explore_stats stats;
+};
+typedef struct worker_t worker;
+
+struct explore_t {
+    explore_config cfg;
+    uint8_t  root_image[IMG_SIZE];
+    state_set* seen;
+    worker*  workers;
+    explore_node* goal;
+    uint64_t pending;           /* nodes queued or being expanded */
+    uint8_t  stop;
+};
+
+/* returns NULL when a new chunk cannot be allocated */
+static void* arena_alloc(worker* w, size_t size) {
+    size = (size + 7) & ~(size_t)7;
+    if (w->arena == NULL || w->arena->used + size > ARENA_CHUNK) {
+        struct arena_chunk_t* chunk = malloc(sizeof(struct arena_chunk_t) + ARENA_CHUNK);
+        if (chunk == NULL)
+            return NULL;
+        chunk->next = w->arena;
+        chunk->used = 0;
+        w->arena = chunk;
+        w->stats.bytes += sizeof(struct arena_chunk_t) + ARENA_CHUNK;
+    }
+    void* p = w->arena->data + w->arena->used;
+    w->arena->used += size;
+    return p;
+}
+
+static void image_pack(chip8* c, uint8_t* img) {
+    memcpy(img + IMG_MEM, c->memory, MEM_SIZE);
+    memcpy(img + IMG_V, c->V, NUM_REGS);
+    memcpy(img + IMG_GFX, c->gfx, WIDTH * HEIGHT);
+    memcpy(img + IMG_STACK, c->stack, STACK_SIZE * 2);
+    uint8_t* r = img + IMG_REGS;
+    memcpy(r, &c->pc, 2);
+    memcpy(r + 2, &c->I, 2);
+    r[4] = c->sp;
+    r[5] = c->delay_timer;
+    r[6] = c->sound_timer;
+    r[7] = 0;
+    memcpy(r + 8, &c->rng, 4);
+    memcpy(r + 12, &c->hash, 8);
+}
+
+static void image_unpack(const uint8_t* img, chip8* c) {
+    memcpy(c->memory, img + IMG_MEM, MEM_SIZE);
+    memcpy(c->V, img + IMG_V, NUM_REGS);
+    memcpy(c->gfx, img + IMG_GFX, WIDTH * HEIGHT);
+    memcpy(c->stack, img + IMG_STACK, STACK_SIZE * 2);
+    const uint8_t* r = img + IMG_REGS;
+    memcpy(&c->pc, r, 2);
+    memcpy(&c->I, r + 2, 2);
+    c->sp = r[4];
+    c->delay_timer = r[5];
+    c->sound_timer = r[6];
+    memcpy(&c->rng, r + 8, 4);
+    memcpy(&c->hash, r + 12, 8);
+
+    c->flags = 0;
+    c->err = ERR_NONE;
+    c->waiting_for_key = 0;
+    memset(c->keys, 0, sizeof(c->keys));
+}
+
+/*
+ * delta of two images as runs of (16-bit offset, length, bytes). runs
+ * are merged across gaps of up to 3 equal bytes, where a new run
+ * header would cost more than the bytes it skips
+ * */
+static uint16_t delta_encode(const uint8_t* from, const uint8_t* to, uint8_t* out) {
+    uint32_t n = 0;
+    uint32_t i = 0;
+    while (i < IMG_SIZE) {
+        if (i + 8 <= IMG_SIZE && !memcmp(from + i, to + i, 8)) {
+            i += 8;
+            continue;
+        }
+        if (from[i] == to[i]) {
+            i++;
+            continue;
+        }
+        uint32_t start = i, end = i + 1;
+        for (uint32_t j=i + 1; j<IMG_SIZE && j - start < 255; j++) {
+            if (from[j] != to[j])
+                end = j + 1;
+            else if (j - end >= 3)
+                break;
+        }
+        out[n++] = start & 0xFF;
+        out[n++] = start >> 8;
+        out[n++] = end - start;
+        memcpy(out + n, to + start, end - start);
+        n += end - start;
+        i = end;
+    }
+    return n;
+}
+
+static void delta_apply(uint8_t* img, const uint8_t* delta, uint16_t size) {
+    uint32_t n = 0;
+    while (n < size) {
+        uint16_t start = delta[n] | delta[n + 1] << 8;
+        uint8_t len = delta[n + 2];
+        memcpy(img + start, delta + n + 3, len);
+        n += 3 + len;
+    }
+}
+
+/*
+ * rebuilds the image of a node from the initial state, the nearest
+ * checkpoint above it and the deltas below that
+ * */
+static void node_image(explore* e, explore_node* n, uint8_t* img) {
+    explore_node* chain[CHECKPOINT_INTERVAL];
+    uint32_t k = 0;
+    while (!n->checkpoint) {
+        chain[k++] = n;
+        n = n->parent;
+    }
+    memcpy(img, e->root_image, IMG_SIZE);
+    delta_apply(img, n->delta, n->delta_size);
+    while (k-- > 0)
+        delta_apply(img, chain[k]->delta, chain[k]->delta_size);
+}
+
+void explore_restore(explore* e, explore_node* n, chip8* c) {
+    uint8_t img[IMG_SIZE];
+    node_image(e, n, img);
+    image_unpack(img, c);
+}
+
+static inline uint16_t fetch(chip8* c) {
+    return c->memory[c->pc] << 8 | c->memory[(c->pc + 1) & MEM_MASK];
+}
+
+static inline uint8_t is_branch(uint16_t op) {
+    uint16_t masked = op & 0xF0FF;
+    return masked == 0xE09E || masked == 0xE0A1 || masked == 0xF00A
+        || (op & 0xF000) == 0xC000;
+}
+
+static inline uint8_t goal_reached(explore* e, chip8* c) {
+    return e->cfg.goal != NULL && e->cfg.goal(c, e->cfg.user);
+}
+
+/*
+ * runs until the next branch instruction, which is not executed. the
+ * goal is checked on every state on the way, so a goal in the middle
+ * of a segment ends it there
+ * */
+static uint8_t run_segment(explore* e, chip8* c) {
+    if (chip8_check_flag(c, HALT))
+        return EXPLORE_HALT;
+    if (goal_reached(e, c))
+        return EXPLORE_GOAL;
+
+    loop_detect l;
+    loop_detect_init(&l, chip8_state_hash(c));
+    for (uint64_t i=0; i<e->cfg.max_segment; i++) {
+        if (is_branch(fetch(c)))
+            return EXPLORE_BRANCH;
+        chip8_emulate_cycle(c);
+        if (chip8_check_flag(c, HALT))
+            return EXPLORE_HALT;
+        if (goal_reached(e, c))
+            return EXPLORE_GOAL;
+        if (loop_detect_step(&l, chip8_state_hash(c)) != 0)
+            return EXPLORE_LOOP;
+    }
+    return EXPLORE_LIMIT;
+}
+
+static int64_t node_priority(explore* e, chip8* c, uint32_t depth) {
+    switch (e->cfg.order) {
+        case EXPLORE_DFS:      return -(int64_t)depth;
+        case EXPLORE_PRIORITY: return e->cfg.priority(c, depth, e->cfg.user);
+    }
+    return depth;
+}
+
+/* returns 1 when the heap cannot grow, the node is not queued then */
+static uint8_t frontier_push(frontier* f, int64_t prio, explore_node* n) {
+    pthread_mutex_lock(&f->lock);
+    if (f->size == f->cap) {
+        uint32_t cap = f->cap ? f->cap * 2 : 1024;
+        frontier_entry* heap = realloc(f->heap, cap * sizeof(frontier_entry));
+        if (heap == NULL) {
+            pthread_mutex_unlock(&f->lock);
+            return 1;
+        }
+        f->heap = heap;
+        f->cap = cap;
+    }
+    uint32_t i = f->size++;
+    while (i > 0 && f->heap[(i - 1) / 2].prio > prio) {
+        f->heap[i] = f->heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    f->heap[i].prio = prio;
+    f->heap[i].node = n;
+    pthread_mutex_unlock(&f->lock);
+    return 0;
+}
+
+static explore_node* frontier_pop(frontier* f) {
+    pthread_mutex_lock(&f->lock);
+    if (f->size == 0) {
+        pthread_mutex_unlock(&f->lock);
+        return NULL;
+    }
+    explore_node* top = f->heap[0].node;
+    frontier_entry last = f->heap[--f->size];
+    uint32_t i = 0;
+    for (;;) {
+        uint32_t child = 2 * i + 1;
+        if (child >= f->size)
+            break;
+        if (child + 1 < f->size && f->heap[child + 1].prio < f->heap[child].prio)
+            child++;
+        if (f->heap[child].prio >= last.prio)
+            break;
+        f->heap[i] = f->heap[child];
+        i = child;
+    }
+    f->heap[i] = last;
+    pthread_mutex_unlock(&f->lock);
+    return top;
+}
+
+/*
+ * takes the best state of its own frontier, or steals the best
+ * state of another worker when it has run out
+ * */
+static explore_node* next_node(explore* e, worker* w) {
+    explore_node* n = frontier_pop(&w->front);
+    for (uint32_t i=1; n == NULL && i<e->cfg.workers; i++)
+        n = frontier_pop(&e->workers[(w->id + i) % e->cfg.workers].front);
+    return n;
+}
+
+static void stop(explore* e) {
+    __atomic_store_n(&e->stop, 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * records a state reached from parent (NULL for the initial state),
+ * returns the new node or NULL if the state was seen before. running
+ * out of memory stops the search like a full state set
+ * */
+static explore_node* node_add(explore* e, worker* w, chip8* c, explore_node* parent,
+                              uint16_t pc, uint8_t kind, uint8_t value, uint8_t end) {
+    if (!state_set_insert_atomic(e->seen, chip8_state_hash(c))) {
+        if (state_set_full(e->seen))
+            stop(e);
+        w->stats.duplicates++;
+        return NULL;
+    }
+
+    uint32_t depth = parent ? parent->depth + 1 : 0;
+    uint8_t checkpoint = depth % CHECKPOINT_INTERVAL == 0;
+    uint16_t delta_size = 0;
+    if (parent != NULL) {
+        image_pack(c, w->child);
+        delta_size = delta_encode(checkpoint ? e->root_image : w->image, w->child, w->delta);
+    }
+
+    explore_node* n = arena_alloc(w, sizeof(explore_node) + delta_size);
+    if (n == NULL) {
+        stop(e);
+        return NULL;
+    }
+    n->parent = parent;
+    n->delta = (uint8_t*)(n + 1);
+    memcpy(n->delta, w->delta, delta_size);
+    n->delta_size = delta_size;
+    n->depth = depth;
+    n->pc = pc;
+    n->kind = kind;
+    n->value = value;
+    n->end = end;
+    n->checkpoint = checkpoint;
+
+    w->stats.states++;
+    if (depth > w->stats.max_depth)
+        w->stats.max_depth = depth;
+    switch (end) {
+        case EXPLORE_HALT:  w->stats.halted++; break;
+        case EXPLORE_LOOP:  w->stats.loops++; break;
+        case EXPLORE_LIMIT: w->stats.truncated++; break;
+    }
+
+    if (goal_reached(e, c)) {
+        explore_node* none = NULL;
+        __atomic_compare_exchange_n(&e->goal, &none, n, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+        stop(e);
+    }
+
+    if (end == EXPLORE_BRANCH && depth < e->cfg.max_depth) {
+        __atomic_add_fetch(&e->pending, 1, __ATOMIC_RELAXED);
+        if (frontier_push(&w->front, node_priority(e, c, depth), n) != 0) {
+            __atomic_sub_fetch(&e->pending, 1, __ATOMIC_RELAXED);
+            stop(e);
+        }
+    }
+    return n;
+}
+
+/*
+ * forks at the branch instruction the node stopped on, each outcome
+ * is applied by executing the instruction with the matching key state
+ * or by overriding the random byte, then run to the next branch
+ * */
+static void expand(explore* e, worker* w, explore_node* n) {
+    chip8* c = w->c;
+    node_image(e, n, w->image);
+    image_unpack(w->image, c);
+
+    uint16_t pc = c->pc;
+    uint16_t op = fetch(c);
+    uint8_t x = (op >> 8) & 0xF;
+    uint8_t kk = op & 0xFF;
+    uint8_t key = c->V[x] & 0xF;
+
+    /*
+     * value runs over the random bytes Cxkk can produce (the submasks
+     * of kk), the keys Fx0A can receive, or pressed/released for Ex9E
+     * and ExA1
+     * */
+    uint8_t kind, value, last;
+    if ((op & 0xF000) == 0xC000) {
+        kind = EXPLORE_RANDOM;
+        value = kk;
+        last = 0;
+    } else if ((op & 0xF0FF) == 0xF00A) {
+        kind = EXPLORE_KEY_WAIT;
+        value = 0;
+        last = NUM_KEYS - 1;
+    } else {
+        kind = EXPLORE_KEY_DOWN;
+        value = 1;
+        last = 0;
+    }
+
+    for (;;) {
+        image_unpack(w->image, c);
+
+        uint8_t child_kind = kind;
+        switch (kind) {
+            case EXPLORE_RANDOM:
+                /* every draw is forked, so the generator state carries no
+                 * information and would only keep equal states apart */
+                chip8_emulate_cycle(c);
+                chip8_reg_set(c, x, value);
+                c->rng = RNG_SEED;
+                break;
+            case EXPLORE_KEY_WAIT:
+                chip8_key_set(c, value, 1);
+                chip8_emulate_cycle(c);
+                break;
+            default:
+                chip8_key_set(c, key, value);
+                child_kind = value ? EXPLORE_KEY_DOWN : EXPLORE_KEY_UP;
+                chip8_emulate_cycle(c);
+                break;
+        }
+        memset(c->keys, 0, sizeof(c->keys));
+
+        uint8_t end = run_segment(e, c);
+        node_add(e, w, c, n, pc, child_kind, (kind == EXPLORE_KEY_DOWN) ? key : value, end);
+
+        if (__atomic_load_n(&e->stop, __ATOMIC_RELAXED))
+            return;
+        if (value == last)
+            break;
+        switch (kind) {
+            case EXPLORE_RANDOM:   value = (value - 1) & kk; break;
+            case EXPLORE_KEY_WAIT: value++; break;
+            default:               value = 0; break;
+        }
+    }
+}
+
+static void* worker_run(void* arg) {
+    worker* w = arg;
+    explore* e = w->e;
+
+    while (!__atomic_load_n(&e->stop, __ATOMIC_RELAXED)) {
+        explore_node* n = next_node(e, w);
+        if (n == NULL) {
+            if (__atomic_load_n(&e->pending, __ATOMIC_ACQUIRE) == 0)
+                break;
+            sched_yield();
+            continue;
+        }
+        expand(e, w, n);
+        __atomic_sub_fetch(&e->pending, 1, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+/*
+ * returns NULL if the rom does not fit in memory or the state set,
+ * the workers or the initial state cannot be allocated
+ * */
+explore* explore_init(const explore_config* cfg, const uint8_t* rom, size_t size) {
+    explore* e = calloc(1, sizeof(explore));
+    if (e == NULL)
+        return NULL;
+    e->cfg = *cfg;
+    if (e->cfg.max_states == 0)  e->cfg.max_states = 1 << 20;
+    if (e->cfg.max_depth == 0)   e->cfg.max_depth = UINT32_MAX;
+    if (e->cfg.max_segment == 0) e->cfg.max_segment = 1000000;
+    if (e->cfg.workers < 1) e->cfg.workers = 1;
+    if (e->cfg.workers > MAX_WORKERS) e->cfg.workers = MAX_WORKERS;
+    e->seen = state_set_init(e->cfg.max_states);
+    e->workers = calloc(e->cfg.workers, sizeof(worker));
+    if (e->seen == NULL || e->workers == NULL) {
+        e->cfg.workers = 0;
+        explore_free(e);
+        return NULL;
+    }
+
+    for (uint32_t i=0; i<e->cfg.workers; i++) {
+        worker* w = &e->workers[i];
+        w->e = e;
+        w->id = i;
+        pthread_mutex_init(&w->front.lock, NULL);
+        w->c = chip8_init();
+        if (w->c == NULL) {
+            /* only the workers set up so far are freed */
+            e->cfg.workers = i + 1;
+            explore_free(e);
+            return NULL;
+        }
+        chip8_quirks_set(w->c, cfg->quirks);
+    }
+
+    chip8* c = e->workers[0].c;
+    if (chip8_program_load_mem(c, rom, size) != 0) {
+        explore_free(e);
+        return NULL;
+    }
+    uint8_t end = run_segment(e, c);
+    image_pack(c, e->root_image);
+    if (node_add(e, &e->workers[0], c, NULL, c->pc, EXPLORE_ROOT, 0, end) == NULL) {
+        explore_free(e);
+        return NULL;
+    }
+    return e;
+}
+
+/*
+ * explores until every reachable state is visited, the goal is found
+ * or the state set is full
+ * */
+void explore_run(explore* e) {
+    for (uint32_t i=0; i<e->cfg.workers; i++)
+        pthread_create(&e->workers[i].thread, NULL, worker_run, &e->workers[i]);
+    for (uint32_t i=0; i<e->cfg.workers; i++)
+        pthread_join(e->workers[i].thread, NULL);
+}
+
+void explore_stats_get(explore* e, explore_stats* stats) {
+    memset(stats, 0, sizeof(explore_stats));
+    for (uint32_t i=0; i<e->cfg.workers; i++) {
+        explore_stats* s = &e->workers[i].stats;
+        stats->states += s->states;
+        stats->duplicates += s->duplicates;
+        stats->halted += s->halted;
+        stats->loops += s->loops;
+        stats->truncated += s->truncated;
+        stats->bytes += s->bytes;
+        if (s->max_depth > stats->max_depth)
+            stats->max_depth = s->max_depth;
+    }
+    stats->bytes += (e->seen->mask + 1) * sizeof(uint64_t);
+}
+
+explore_node* explore_goal(explore* e) {
+    return __atomic_load_n(&e->goal, __ATOMIC_ACQUIRE);
+}
+
+/*
+ * fills path with the nodes from the initial state down to n,
+ * returns their number
+ * */
+uint32_t explore_path(explore_node* n, explore_node** path, uint32_t max) {
+    uint32_t len = n->depth + 1;
+    for (uint32_t i=len; i-- > 0; n=n->parent)
+        if (i < max)
+            path[i] = n;
+    return len;
+}
+
+void explore_free(explore* e) {
+    for (uint32_t i=0; i<e->cfg.workers; i++) {
+        worker* w = &e->workers[i];
+        while (w->arena != NULL) {
+            struct arena_chunk_t* next = w->arena->next;
+            free(w->arena);
+            w->arena = next;
+        }
+        free(w->front.heap);
+        pthread_mutex_destroy(&w->front.lock);
+        if (w->c != NULL)
+            chip8_free(w->c);
+    }
+    free(e->workers);
+    if (e->seen != NULL)
+        state_set_free(e->seen);
+    free(e);
+}
@@ -0,0 +1,87 @@
+#ifndef EXPLORE_H
+#define EXPLORE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "chip8.h"
+#include "state.h"
+
+/*
+ * explicit-state explorer: runs a rom deterministically until the next
+ * instruction that depends on input (Ex9E, ExA1, Fx0A) or on Cxkk, and
+ * forks the machine there for every possible outcome. states are
+ * deduplicated by chip8_state_hash in a shared state_set, and each one
+ * is stored as a delta from its parent, with every CHECKPOINT_INTERVAL-th
+ * level stored as a delta from the initial state instead
+ * */
+
+#define CHECKPOINT_INTERVAL 16
+
+/* search order */
+#define EXPLORE_BFS      0
+#define EXPLORE_DFS      1
+#define EXPLORE_PRIORITY 2
+
+/* outcome of the branch instruction that led to a state */
+#define EXPLORE_ROOT     0
+#define EXPLORE_KEY_DOWN 1  /* Ex9E/ExA1 with key Vx pressed */
+#define EXPLORE_KEY_UP   2  /* Ex9E/ExA1 with key Vx released */
+#define EXPLORE_KEY_WAIT 3  /* Fx0A receiving key value */
+#define EXPLORE_RANDOM   4  /* Cxkk drawing value */
+
+/* how the deterministic run after the branch ended */
+#define EXPLORE_BRANCH   0  /* at the next branch instruction */
+#define EXPLORE_HALT     1
+#define EXPLORE_LOOP     2  /* loops forever without reaching a branch */
+#define EXPLORE_LIMIT    3  /* max_segment cycles without a branch */
+#define EXPLORE_GOAL     4  /* the goal holds before the next branch */
+
+struct explore_node_t {
+    struct explore_node_t* parent;
+    uint8_t* delta;
+    uint32_t depth;
+    uint16_t delta_size;
+    uint16_t pc;        /* branch instruction taken from the parent */
+    uint8_t  kind;
+    uint8_t  value;     /* key or random byte */
+    uint8_t  end;
+    uint8_t  checkpoint;
+};
+typedef struct explore_node_t explore_node;
+
+struct explore_config_t {
+    uint8_t  quirks;
+    uint8_t  order;
+    uint32_t workers;
+    uint32_t max_states;        /* capacity of the state set, 0 for 1M */
+    uint32_t max_depth;         /* in branches, 0 for no limit */
+    uint64_t max_segment;       /* cycles between branches, 0 for 1M */
+
+    /* EXPLORE_PRIORITY: states with the lowest value are expanded first */
+    int64_t  (*priority)(chip8* c, uint32_t depth, void* user);
+    /* stops the search at the first state for which it returns nonzero */
+    uint8_t  (*goal)(chip8* c, void* user);
+    void*    user;
+};
+typedef struct explore_config_t explore_config;
+
+struct explore_stats_t {
+    uint64_t states;
+    uint64_t duplicates;
+    uint64_t halted, loops, truncated;
+    uint64_t bytes;             /* nodes and deltas */
+    uint32_t max_depth;
+};
+typedef struct explore_stats_t explore_stats;
+
+typedef struct explore_t explore;
+
+explore*      explore_init(const explore_config* cfg, const uint8_t* rom, size_t size);
+void          explore_free(explore* e);
+void          explore_run(explore* e);
+void          explore_stats_get(explore* e, explore_stats* stats);
+explore_node* explore_goal(explore* e);
+uint32_t      explore_path(explore_node* n, explore_node** path, uint32_t max);
+void          explore_restore(explore* e, explore_node* n, chip8* c);
+
+#endif
@@ -0,0 +1,51 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "framebuf.h"
+
+framebuf* framebuf_init() {
+    framebuf* f;
+    if (posix_memalign((void**)&f, 64, sizeof(framebuf)) != 0)
+        return NULL;
+    memset(f->buf, 0, sizeof(f->buf));
+    memset(f->stamp, 0, sizeof(f->stamp));
+    f->back = 0;
+    f->middle = 1;
+    f->front = 2;
+    return f;
+}
+
+void framebuf_free(framebuf* f) {
+    free(f);
+}
+
+/*
+ * copies a completed frame into the back buffer and makes it
+ * the newest one, replacing a frame the consumer has not taken yet
+ * */
+void framebuf_publish(framebuf* f, const uint8_t* gfx) {
+    framebuf_publish_stamped(f, gfx, 0);
+}
+
+/*
+ * publishes a frame with a value the consumer gets along with it, the
+ * exchange orders it like the pixels
+ * */
+void framebuf_publish_stamped(framebuf* f, const uint8_t* gfx, uint64_t stamp) {
+    memcpy(f->buf[f->back], gfx, WIDTH * HEIGHT);
+    f->stamp[f->back] = stamp;
+    uint8_t old = __atomic_exchange_n(&f->middle, f->back | FRAME_FRESH, __ATOMIC_ACQ_REL);
+    f->back = old & 0x3;
+}
+
+/*
+ * returns the newest frame, or NULL if nothing was published since
+ * the last call. the frame stays valid until the next call
+ * */
+uint8_t* framebuf_acquire(framebuf* f) {
+    if ((__atomic_load_n(&f->middle, __ATOMIC_ACQUIRE) & FRAME_FRESH) == 0)
+        return NULL;
+    uint8_t old = __atomic_exchange_n(&f->middle, f->front, __ATOMIC_ACQ_REL);
+    f->front = old & 0x3;
+    return f->buf[f->front];
+}
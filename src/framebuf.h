@@ -0,0 +1,35 @@
+#ifndef FRAMEBUF_H
+#define FRAMEBUF_H
+
+#include <stdint.h>
+#include "chip8.h"
+
+#define FRAME_FRESH 0x4
+
+/*
+ * lock-free triple buffer of gfx snapshots
+ *
+ * the producer owns back, the consumer owns front and they swap their
+ * buffer with middle using an atomic exchange. the producer can always
+ * publish a frame and the consumer always gets the most recent one, so
+ * neither side ever waits for the other
+ * */
+struct framebuf_t {
+    uint8_t buf[3][WIDTH * HEIGHT];
+    uint64_t stamp[3];
+    uint8_t back  __attribute__((aligned(64)));
+    uint8_t front __attribute__((aligned(64)));
+    uint8_t middle __attribute__((aligned(64)));
+};
+typedef struct framebuf_t framebuf;
+
+framebuf* framebuf_init();
+void      framebuf_free(framebuf* f);
+void      framebuf_publish(framebuf* f, const uint8_t* gfx);
+void      framebuf_publish_stamped(framebuf* f, const uint8_t* gfx, uint64_t stamp);
+uint8_t*  framebuf_acquire(framebuf* f);
+
+/* stamp of the frame returned by the last framebuf_acquire */
+static inline uint64_t framebuf_stamp(framebuf* f) { return f->stamp[f->front]; }
+
+#endif
@@ -0,0 +1,119 @@
+#include <stdint.h>
+#include <string.h>
+#include "input.h"
+
+/*
+ * fills a 256 entry table from scancode to chip8 key, scancodes
+ * without a key map to INPUT_NO_KEY
+ * */
+void input_map_init(int8_t* lut, const uint8_t* scancodes, const uint8_t* keys, uint8_t n) {
+    memset(lut, INPUT_NO_KEY, 256);
+    for (uint8_t i=0; i<n; i++)
+        lut[scancodes[i]] = keys[i];
+}
+
+void input_queue_init(input_queue* q, uint32_t cycles_per_second) {
+    ring_init(&q->events);
+    q->cycles_per_second = cycles_per_second;
+    q->start_us = 0;
+    q->base_cycle = 0;
+    q->applied_us = 0;
+}
+
+/*
+ * cycle runs at now_us, called when emulation starts and whenever it
+ * stops following the wall clock, e.g. after a debugger prompt
+ * */
+void input_clock_set(input_queue* q, uint64_t now_us, uint64_t cycle) {
+    q->start_us = now_us;
+    q->base_cycle = cycle;
+}
+
+/*
+ * the cycle that runs at t_us, events from before the clock was last
+ * set happen at its base cycle
+ * */
+uint64_t input_cycle(input_queue* q, uint64_t t_us) {
+    if (t_us < q->start_us)
+        return q->base_cycle;
+    return q->base_cycle + (t_us - q->start_us) * q->cycles_per_second / 1000000;
+}
+
+/*
+ * cycle at which the oldest queued event is due, UINT64_MAX if
+ * nothing is queued
+ * */
+uint64_t input_next_cycle(input_queue* q) {
+    uint64_t event;
+    if (!ring_peek(&q->events, &event))
+        return UINT64_MAX;
+    return input_cycle(q, input_event_time(event));
+}
+
+/*
+ * applies the events due at or before cycle in the order they were
+ * polled
+ * */
+void input_apply(input_queue* q, chip8* c, uint64_t cycle) {
+    uint64_t event;
+    while (ring_peek(&q->events, &event) && input_cycle(q, input_event_time(event)) <= cycle) {
+        chip8_key_set(c, input_event_key(event), input_event_down(event));
+        q->applied_us = input_event_time(event);
+        ring_drop(&q->events);
+    }
+}
+
+void input_latency_init(input_latency* l) {
+    memset(l, 0, sizeof(input_latency));
+}
+
+/*
+ * remembers an event that was queued, when too many are waiting for a
+ * frame the oldest is dropped from the statistics
+ * */
+void input_latency_sent(input_latency* l, uint64_t t_us) {
+    if (l->head - l->tail == INPUT_PENDING) {
+        l->tail++;
+        l->dropped++;
+    }
+    l->pending[l->head++ % INPUT_PENDING] = t_us;
+}
+
+/*
+ * a frame rendered after every event up to applied_us is now on screen,
+ * the latency of those events is the time since they were polled
+ * */
+void input_latency_presented(input_latency* l, chip8_counters* k, uint64_t applied_us, uint64_t now_us) {
+    while (l->tail != l->head && l->pending[l->tail % INPUT_PENDING] <= applied_us) {
+        uint64_t t = l->pending[l->tail++ % INPUT_PENDING];
+        uint64_t us = now_us > t ? now_us - t : 0;
+        uint64_t bucket = us / LATENCY_BUCKET_US;
+
+        l->hist[bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1]++;
+        l->count++;
+        l->sum_us += us;
+        if (us > l->max_us)
+            l->max_us = us;
+        if (k != NULL) {
+            counter_add(&k->inputs, 1);
+            counter_add(&k->input_latency_us, us);
+        }
+    }
+}
+
+/*
+ * upper bound of the bucket holding the pct-th percentile, the last
+ * bucket also holds everything slower and reports the maximum
+ * */
+uint64_t input_latency_percentile(input_latency* l, uint8_t pct) {
+    uint64_t rank = (l->count * pct + 99) / 100;
+    uint64_t seen = 0;
+    for (uint8_t i=0; i<LATENCY_BUCKETS - 1; i++) {
+        seen += l->hist[i];
+        if (seen >= rank && seen > 0) {
+            uint64_t upper = (uint64_t)(i + 1) * LATENCY_BUCKET_US;
+            return upper < l->max_us ? upper : l->max_us;
+        }
+    }
+    return l->max_us;
+}
@@ -0,0 +1,66 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdint.h>
+#include "chip8.h"
+#include "ring.h"
+#include "metrics.h"
+
+#define INPUT_NO_KEY      (-1)
+#define INPUT_PENDING     256   /* inputs waiting for their first frame */
+#define LATENCY_BUCKETS   64
+#define LATENCY_BUCKET_US 500
+
+/*
+ * key events cross from the ui thread to the emulation thread as one
+ * ring value: the time the event was polled in microseconds, the key
+ * and whether it went down
+ * */
+static inline uint64_t input_event(uint64_t t_us, uint8_t key, uint8_t down) {
+    return t_us << 5 | (key & 0xF) << 1 | (down & 1);
+}
+static inline uint64_t input_event_time(uint64_t e) { return e >> 5; }
+static inline uint8_t  input_event_key(uint64_t e)  { return (e >> 1) & 0xF; }
+static inline uint8_t  input_event_down(uint64_t e) { return e & 1; }
+
+/*
+ * the emulation side. the clock maps wall time to the emulated cycle
+ * that runs at that time, so an event is applied right before the
+ * cycle matching the moment it was polled, however late the thread
+ * gets to it
+ * */
+struct input_queue_t {
+    ring     events;
+    uint64_t start_us, base_cycle;
+    uint32_t cycles_per_second;
+    uint64_t applied_us;      /* time of the newest applied event */
+};
+typedef struct input_queue_t input_queue;
+
+/*
+ * the presenting side, it remembers the time of every event it sent
+ * until a frame that was rendered after the event is on screen
+ * */
+struct input_latency_t {
+    uint64_t pending[INPUT_PENDING];
+    uint32_t head, tail;
+    uint64_t count, dropped;
+    uint64_t sum_us, max_us;
+    uint64_t hist[LATENCY_BUCKETS];
+};
+typedef struct input_latency_t input_latency;
+
+void     input_map_init(int8_t* lut, const uint8_t* scancodes, const uint8_t* keys, uint8_t n);
+
+void     input_queue_init(input_queue* q, uint32_t cycles_per_second);
+void     input_clock_set(input_queue* q, uint64_t now_us, uint64_t cycle);
+uint64_t input_cycle(input_queue* q, uint64_t t_us);
+uint64_t input_next_cycle(input_queue* q);
+void     input_apply(input_queue* q, chip8* c, uint64_t cycle);
+
+void     input_latency_init(input_latency* l);
+void     input_latency_sent(input_latency* l, uint64_t t_us);
+void     input_latency_presented(input_latency* l, chip8_counters* k, uint64_t applied_us, uint64_t now_us);
+uint64_t input_latency_percentile(input_latency* l, uint8_t pct);
+
+#endif
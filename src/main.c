@@ -1,16 +1,50 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <time.h>
+#include <pthread.h>
 #include <SDL/SDL.h>
 
 #include "chip8.h"
 #include "display.h"
+#include "quirks.h"
+#include "debugger.h"
+#include "audio.h"
+#include "framebuf.h"
+#include "ring.h"
+#include "input.h"
+#include "metrics.h"
+
+#define CYCLES_PER_SECOND 1000
+#define METRICS_INTERVAL  1000 /* ms */
 
 int debug = 0;
+int interactive = 0;
 int dump = 0;
 char* filename = "games/demo.c8";
+char* quirks_filename = NULL;
+char* wav_filename = NULL;
+char* metrics_target = NULL;
 SDL_Event event;
 
+/*
+ * emulation runs on its own thread at a steady rate, the main thread
+ * only presents frames and handles sdl events. frames go out through
+ * a triple buffer and timestamped key events come back through an spsc
+ * ring, so a slow flip never holds up the emulation and every key
+ * reaches the machine at the cycle matching the time it was pressed
+ * */
+struct emulator_t {
+    input_queue input;
+    chip8*    c;
+    debugger* dbg;
+    audio*    a;
+    framebuf* frames;
+    int       running;
+};
+struct emulator_t emu;
+
 uint8_t scancodes[NUM_KEYS] = {
     0x0a, 0x0b, 0x0c, 0x0d, // 1 2 3 4
     0x18, 0x19, 0x1a, 0x1b, // q w e r
@@ -25,16 +59,30 @@ uint8_t key_map[NUM_KEYS] = {
     0x0a, 0x00, 0x0b, 0x0f  // a 0 b f
 };
 
+int8_t key_lut[256];
+
 int parse_args(int argc, char** argv) {
     int c;
-    while ((c = getopt(argc, argv, "dm")) != -1) {
+    while ((c = getopt(argc, argv, "dgmM:q:w:")) != -1) {
         switch (c) {
             case 'd':
                 debug = 1;
                 break;
+            case 'g':
+                interactive = 1;
+                break;
             case 'm':
                 dump = 1;
                 break;
+            case 'M':
+                metrics_target = optarg;
+                break;
+            case 'q':
+                quirks_filename = optarg;
+                break;
+            case 'w':
+                wav_filename = optarg;
+                break;
             case '?':
                 printf("%s", optarg);
             default:
@@ -48,6 +96,81 @@ int parse_args(int argc, char** argv) {
 
 }
 
+static void log_error(chip8* c, void* user) {
+    char reason[64];
+    fprintf(stderr, "%s: %s\n", (char*)user, chip8_strerror(c, reason, sizeof(reason)));
+}
+
+static uint64_t time_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static void emulator_stop(struct emulator_t* e) {
+    __atomic_store_n(&e->running, 0, __ATOMIC_RELEASE);
+}
+
+static int emulator_running(struct emulator_t* e) {
+    return __atomic_load_n(&e->running, __ATOMIC_ACQUIRE);
+}
+
+void* emulator_run(void* arg) {
+    struct emulator_t* e = arg;
+    chip8* c = e->c;
+
+    if (e->dbg && debugger_prompt(e->dbg, c))
+        emulator_stop(e);
+
+    input_clock_set(&e->input, time_us(), c->cycles);
+
+    while (emulator_running(e)) {
+
+        uint64_t target = input_cycle(&e->input, time_us());
+        uint64_t next_input = input_next_cycle(&e->input);
+
+        while (c->cycles < target && !chip8_check_flag(c,HALT)) {
+
+            if (c->cycles >= next_input) {
+                input_apply(&e->input, c, c->cycles);
+                next_input = input_next_cycle(&e->input);
+            }
+
+            if (e->dbg && debugger_check(e->dbg, c)) {
+                if (debugger_prompt(e->dbg, c)) {
+                    emulator_stop(e);
+                    break;
+                }
+                /* don't try to catch up on the time spent in the prompt,
+                 * keys pressed meanwhile are applied right away */
+                input_clock_set(&e->input, time_us(), c->cycles);
+                target = c->cycles;
+                next_input = input_next_cycle(&e->input);
+            }
+
+            chip8_emulate_cycle(c);
+
+            if (debug)
+                chip8_debug_print(c);
+
+            if (chip8_check_flag(c,DRAW)) {
+                framebuf_publish_stamped(e->frames, c->gfx, e->input.applied_us);
+                c->flags ^= DRAW;
+            }
+        }
+
+        /* a halted machine still takes its keys off the ring */
+        if (chip8_check_flag(c,HALT))
+            input_apply(&e->input, c, target);
+
+        if (wav_filename != NULL)
+            audio_pump(e->a, c->cycles);
+
+        usleep(1000);
+    }
+    return NULL;
+}
+
 int main(int argc, char** argv) {
 
     if (parse_args(argc, argv) != 0) {
@@ -55,60 +178,107 @@ int main(int argc, char** argv) {
     }
 
     chip8* c = chip8_init();
+    c->log = log_error;
+    c->log_user = filename;
 
     if (chip8_program_load(c, filename) != 0) {
         chip8_free(c);
         return 1;
     }
 
+    if (quirks_filename) {
+        quirks_db* db = quirks_db_load(quirks_filename);
+        if (db != NULL) {
+            quirks_db_apply(db, c);
+            quirks_db_free(db);
+        }
+    }
+
     if (dump)
         chip8_mem_dump(c);
 
     display* d = display_init(WIDTH, HEIGHT);
 
-    int running = 1;
+    audio* a = audio_init(SAMPLE_RATE, CYCLES_PER_SECOND);
+    if (wav_filename != NULL)
+        audio_wav_open(a, wav_filename);
+    else
+        audio_sdl_open(a);
+    audio_attach(a, c);
 
-    while (running) {
-        if (!chip8_check_flag(c,HALT)) {
-
-            chip8_emulate_cycle(c);
+    input_map_init(key_lut, scancodes, key_map, NUM_KEYS);
+    input_queue_init(&emu.input, CYCLES_PER_SECOND);
+    input_latency latency;
+    input_latency_init(&latency);
+    emu.c = c;
+    emu.a = a;
+    emu.frames = framebuf_init();
+    emu.dbg = interactive ? debugger_init(stdin, stdout) : NULL;
+    emu.running = 1;
 
-            if (debug)
-                chip8_debug_print(c);
+    /* json when the target name ends in .json, text lines otherwise */
+    metrics* m = NULL;
+    if (metrics_target) {
+        size_t len = strlen(metrics_target);
+        uint8_t format = (len > 5 && !strcmp(metrics_target + len - 5, ".json")) ? METRICS_JSON : METRICS_TEXT;
+        m = metrics_init();
+        metrics_register(m, filename, c);
+        if (metrics_dump_start(m, metrics_target, METRICS_INTERVAL, format) != 0)
+            fprintf(stderr, "could not export metrics to \"%s\"\n", metrics_target);
+    }
 
-            if (chip8_check_flag(c,DRAW)) {
-                display_draw(d, c->gfx);
-                c->flags ^= DRAW;
-            }
+    pthread_t emulator_thread;
+    pthread_create(&emulator_thread, NULL, emulator_run, &emu);
 
-        }
+    while (emulator_running(&emu)) {
 
         while ( SDL_PollEvent(&event) ) {
             switch (event.type) {
                 case SDL_QUIT:
-                    running = 0;
+                    emulator_stop(&emu);
                     break;
                 case SDL_KEYUP:
-                case SDL_KEYDOWN:
-                    for (uint8_t i=0; i<NUM_KEYS; i++) {
-                        if (event.key.keysym.scancode == scancodes[i]) {
-                            uint8_t state = (event.type == SDL_KEYDOWN) ? 1 : 0;
-                            chip8_key_set(c, key_map[i], state);
-                            break;
-                        }
-                    }
+                case SDL_KEYDOWN: {
+                    int8_t key = key_lut[event.key.keysym.scancode];
+                    if (key == INPUT_NO_KEY)
+                        break;
+                    uint64_t now = time_us();
+                    uint8_t state = (event.type == SDL_KEYDOWN) ? 1 : 0;
+                    if (ring_push(&emu.input.events, input_event(now, key, state)))
+                        input_latency_sent(&latency, now);
                     break;
+                }
                 default:
                     break;
             }
+        }
 
+        uint8_t* frame = framebuf_acquire(emu.frames);
+        if (frame != NULL) {
+            display_draw(d, frame);
+            counter_add(&c->counters->frames, 1);
+            input_latency_presented(&latency, c->counters, framebuf_stamp(emu.frames), time_us());
         }
-            if (event.type == SDL_QUIT)
-                running = 0;
 
         SDL_Delay(1);
     }
 
+    pthread_join(emulator_thread, NULL);
+
+    if (latency.count > 0)
+        fprintf(stderr, "input to display latency over %llu keys: mean %.1f ms, p50 %.1f ms, p99 %.1f ms, max %.1f ms\n",
+                (unsigned long long)latency.count, latency.sum_us / 1000.0 / latency.count,
+                input_latency_percentile(&latency, 50) / 1000.0,
+                input_latency_percentile(&latency, 99) / 1000.0, latency.max_us / 1000.0);
+
+    if (m)
+        metrics_free(m);
+    if (emu.dbg)
+        debugger_free(emu.dbg);
+    framebuf_free(emu.frames);
+    if (wav_filename == NULL)
+        audio_sdl_close(a);
+    audio_free(a);
     chip8_free(c);
     display_free(d);
 
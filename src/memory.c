@@ -0,0 +1,80 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "memory.h"
+
+/* allocated on first use, NULL if that fails */
+static watch* chip8_watch_get(chip8* c) {
+    if (c->watch == NULL)
+        c->watch = calloc(1, sizeof(watch));
+    return c->watch;
+}
+
+/*
+ * recomputes which pages contain at least one watched address
+ * */
+static void chip8_watch_pages_update(chip8* c) {
+    watch* w = c->watch;
+    uint16_t pages = 0;
+    for (uint16_t i=0; i<MEM_SIZE/8; i++) {
+        if (w->read[i] | w->write[i])
+            pages |= 1 << ((i * 8) >> PAGE_SHIFT);
+    }
+    c->watch_pages = pages;
+}
+
+/*
+ * watch addresses start..end (inclusive) for the given access types,
+ * returns 1 if the watchpoints cannot be allocated
+ * */
+uint8_t chip8_watch_add(chip8* c, uint16_t start, uint16_t end, uint8_t access) {
+    watch* w = chip8_watch_get(c);
+    if (w == NULL)
+        return 1;
+    for (uint16_t a=start & MEM_MASK; a<=(end & MEM_MASK); a++) {
+        if (access & WATCH_READ)  w->read[a >> 3]  |= 1 << (a & 7);
+        if (access & WATCH_WRITE) w->write[a >> 3] |= 1 << (a & 7);
+    }
+    chip8_watch_pages_update(c);
+    return 0;
+}
+
+void chip8_watch_remove(chip8* c, uint16_t start, uint16_t end, uint8_t access) {
+    if (c->watch == NULL)
+        return;
+    watch* w = c->watch;
+    for (uint16_t a=start & MEM_MASK; a<=(end & MEM_MASK); a++) {
+        if (access & WATCH_READ)  w->read[a >> 3]  &= ~(1 << (a & 7));
+        if (access & WATCH_WRITE) w->write[a >> 3] &= ~(1 << (a & 7));
+    }
+    chip8_watch_pages_update(c);
+}
+
+/*
+ * returns 1 if the watchpoints cannot be allocated
+ * */
+uint8_t chip8_watch_callback_set(chip8* c, chip8_watch_func func, void* user) {
+    watch* w = chip8_watch_get(c);
+    if (w == NULL)
+        return 1;
+    w->callback = func;
+    w->user = user;
+    return 0;
+}
+
+/*
+ * slow path of chip8_mem_read8/chip8_mem_write8, only reached for
+ * addresses on a page with watchpoints
+ * */
+void chip8_watch_hit(chip8* c, uint16_t addr, uint8_t access) {
+    watch* w = c->watch;
+    uint8_t* bits = (access == WATCH_READ) ? w->read : w->write;
+    if ((bits[addr >> 3] & (1 << (addr & 7))) == 0)
+        return;
+
+    if (w->callback != NULL)
+        w->callback(c, addr, access, w->user);
+    else
+        fprintf(stderr, "watchpoint: %s 0x%03X at pc 0x%03X\n",
+                (access == WATCH_READ) ? "read" : "write", addr, c->pc);
+}
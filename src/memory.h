@@ -0,0 +1,30 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <stdint.h>
+#include "chip8.h"
+
+#define NUM_PAGES (MEM_SIZE >> PAGE_SHIFT)
+
+typedef void (*chip8_watch_func)(chip8* c, uint16_t addr, uint8_t access, void* user);
+
+/*
+ * watchpoints on memory ranges
+ *
+ * one bit per address and access type, the pages containing any of
+ * them are mirrored in chip8.watch_pages so that accesses to other
+ * pages never look at this struct
+ * */
+struct watch_t {
+    uint8_t          read[MEM_SIZE / 8];
+    uint8_t          write[MEM_SIZE / 8];
+    chip8_watch_func callback;
+    void*            user;
+};
+typedef struct watch_t watch;
+
+uint8_t chip8_watch_add(chip8* c, uint16_t start, uint16_t end, uint8_t access);
+void    chip8_watch_remove(chip8* c, uint16_t start, uint16_t end, uint8_t access);
+uint8_t chip8_watch_callback_set(chip8* c, chip8_watch_func func, void* user);
+
+#endif
@@ -0,0 +1,330 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "metrics.h"
+
+#define METRICS_SOCKET_PREFIX "unix:"
+
+static uint64_t time_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+/*
+ * copies a counter block that is being written by other threads, each
+ * counter is exact but they are not all taken at the same instant
+ * */
+void counters_read(const chip8_counters* src, chip8_counters* dst) {
+    memset(dst, 0, sizeof(chip8_counters));
+    dst->instructions = counter_get(&src->instructions);
+    dst->draws        = counter_get(&src->draws);
+    dst->clears       = counter_get(&src->clears);
+    dst->timer_ticks  = counter_get(&src->timer_ticks);
+    dst->halts        = counter_get(&src->halts);
+    for (uint8_t i=0; i<NUM_ERRORS; i++)
+        dst->errors[i] = counter_get(&src->errors[i]);
+    dst->frames       = counter_get(&src->frames);
+    dst->inputs       = counter_get(&src->inputs);
+    dst->input_latency_us = counter_get(&src->input_latency_us);
+}
+
+static void counters_sum(chip8_counters* total, const chip8_counters* a) {
+    total->instructions += a->instructions;
+    total->draws        += a->draws;
+    total->clears       += a->clears;
+    total->timer_ticks  += a->timer_ticks;
+    total->halts        += a->halts;
+    for (uint8_t i=0; i<NUM_ERRORS; i++)
+        total->errors[i] += a->errors[i];
+    total->frames       += a->frames;
+    total->inputs       += a->inputs;
+    total->input_latency_us += a->input_latency_us;
+}
+
+metrics* metrics_init() {
+    metrics* m = calloc(1, sizeof(metrics));
+    pthread_mutex_init(&m->lock, NULL);
+    m->sample_us = time_us();
+    m->listen_fd = -1;
+    return m;
+}
+
+void metrics_free(metrics* m) {
+    metrics_dump_stop(m);
+    pthread_mutex_destroy(&m->lock);
+    free(m->entries);
+    free(m);
+}
+
+/*
+ * adds an instance to the report, it has to be unregistered before it
+ * is freed
+ * */
+void metrics_register(metrics* m, const char* name, chip8* c) {
+    pthread_mutex_lock(&m->lock);
+    if (m->num_entries == m->max_entries) {
+        m->max_entries = m->max_entries ? m->max_entries * 2 : 16;
+        m->entries = realloc(m->entries, m->max_entries * sizeof(metrics_entry));
+    }
+    metrics_entry* e = &m->entries[m->num_entries++];
+    memset(e, 0, sizeof(metrics_entry));
+    snprintf(e->name, METRICS_NAME_SIZE, "%s", name);
+    e->c = c;
+    counters_read(c->counters, &e->now);
+    e->last = e->now;
+    pthread_mutex_unlock(&m->lock);
+}
+
+void metrics_unregister(metrics* m, chip8* c) {
+    pthread_mutex_lock(&m->lock);
+    for (uint32_t i=0; i<m->num_entries; i++) {
+        if (m->entries[i].c == c) {
+            m->entries[i] = m->entries[--m->num_entries];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&m->lock);
+}
+
+/*
+ * reads the counters of every instance and updates the rates to the
+ * average since the previous sample
+ * */
+void metrics_sample(metrics* m) {
+    pthread_mutex_lock(&m->lock);
+    uint64_t now = time_us();
+    double seconds = (now - m->sample_us) / 1e6;
+    m->sample_us = now;
+
+    for (uint32_t i=0; i<m->num_entries; i++) {
+        metrics_entry* e = &m->entries[i];
+        e->last = e->now;
+        counters_read(e->c->counters, &e->now);
+        if (seconds > 0) {
+            e->mips = (e->now.instructions - e->last.instructions) / seconds / 1e6;
+            e->fps  = (e->now.frames - e->last.frames) / seconds;
+        }
+    }
+    pthread_mutex_unlock(&m->lock);
+}
+
+/*
+ * sum of the current counters of all instances
+ * */
+void metrics_total(metrics* m, chip8_counters* total) {
+    chip8_counters current;
+    memset(total, 0, sizeof(chip8_counters));
+    pthread_mutex_lock(&m->lock);
+    for (uint32_t i=0; i<m->num_entries; i++) {
+        counters_read(m->entries[i].c->counters, &current);
+        counters_sum(total, &current);
+    }
+    pthread_mutex_unlock(&m->lock);
+}
+
+/* instance names are file names, escape them for json strings and labels */
+static void write_escaped(FILE* f, const char* s) {
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\')
+            fprintf(f, "\\%c", *s);
+        else if ((uint8_t)*s < 0x20)
+            fprintf(f, "\\u%04x", *s);
+        else
+            fputc(*s, f);
+    }
+}
+
+static void write_text(FILE* f, const char* name, const char* metric, uint64_t val) {
+    fprintf(f, "chip8_%s{instance=\"", metric);
+    write_escaped(f, name);
+    fprintf(f, "\"} %llu\n", (unsigned long long)val);
+}
+
+static void write_entry_text(FILE* f, metrics_entry* e) {
+    write_text(f, e->name, "instructions_total", e->now.instructions);
+    write_text(f, e->name, "draws_total", e->now.draws);
+    write_text(f, e->name, "clears_total", e->now.clears);
+    write_text(f, e->name, "frames_total", e->now.frames);
+    write_text(f, e->name, "timer_ticks_total", e->now.timer_ticks);
+    write_text(f, e->name, "halts_total", e->now.halts);
+    write_text(f, e->name, "inputs_total", e->now.inputs);
+    write_text(f, e->name, "input_latency_us_total", e->now.input_latency_us);
+    for (uint8_t i=ERR_NONE+1; i<NUM_ERRORS; i++) {
+        fprintf(f, "chip8_errors_total{instance=\"");
+        write_escaped(f, e->name);
+        fprintf(f, "\",reason=\"%s\"} %llu\n", chip8_error_name(i), (unsigned long long)e->now.errors[i]);
+    }
+    fprintf(f, "chip8_mips{instance=\"");
+    write_escaped(f, e->name);
+    fprintf(f, "\"} %.3f\n", e->mips);
+    fprintf(f, "chip8_fps{instance=\"");
+    write_escaped(f, e->name);
+    fprintf(f, "\"} %.1f\n", e->fps);
+}
+
+static void write_entry_json(FILE* f, metrics_entry* e) {
+    fprintf(f, "{\"instance\":\"");
+    write_escaped(f, e->name);
+    fprintf(f, "\",\"instructions\":%llu,\"draws\":%llu,\"clears\":%llu,\"frames\":%llu,"
+               "\"timer_ticks\":%llu,\"halts\":%llu,\"inputs\":%llu,\"input_latency_us\":%llu,\"errors\":{",
+            (unsigned long long)e->now.instructions, (unsigned long long)e->now.draws,
+            (unsigned long long)e->now.clears, (unsigned long long)e->now.frames,
+            (unsigned long long)e->now.timer_ticks, (unsigned long long)e->now.halts,
+            (unsigned long long)e->now.inputs, (unsigned long long)e->now.input_latency_us);
+    for (uint8_t i=ERR_NONE+1; i<NUM_ERRORS; i++)
+        fprintf(f, "%s\"%s\":%llu", i > ERR_NONE+1 ? "," : "", chip8_error_name(i),
+                (unsigned long long)e->now.errors[i]);
+    fprintf(f, "},\"mips\":%.3f,\"fps\":%.1f}", e->mips, e->fps);
+}
+
+/*
+ * writes the last sample, as prometheus style text lines or as a json
+ * object with one element per instance
+ * */
+void metrics_write(metrics* m, FILE* f, uint8_t format) {
+    pthread_mutex_lock(&m->lock);
+    if (format == METRICS_JSON)
+        fprintf(f, "{\"instances\":[");
+    for (uint32_t i=0; i<m->num_entries; i++) {
+        if (format == METRICS_JSON) {
+            if (i > 0)
+                fputc(',', f);
+            write_entry_json(f, &m->entries[i]);
+        } else {
+            write_entry_text(f, &m->entries[i]);
+        }
+    }
+    if (format == METRICS_JSON)
+        fprintf(f, "]}\n");
+    pthread_mutex_unlock(&m->lock);
+}
+
+/*
+ * the file is replaced with a rename so a reader never sees it half
+ * written
+ * */
+static void dump_file(metrics* m) {
+    char tmp[512];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", m->path);
+    FILE* f = fopen(tmp, "w");
+    if (f == NULL)
+        return;
+    metrics_write(m, f, m->format);
+    fclose(f);
+    rename(tmp, m->path);
+}
+
+static void dump_client(metrics* m) {
+    int fd = accept(m->listen_fd, NULL, NULL);
+    if (fd < 0)
+        return;
+    FILE* f = fdopen(fd, "w");
+    if (f == NULL) {
+        close(fd);
+        return;
+    }
+    metrics_write(m, f, m->format);
+    fclose(f);
+}
+
+static void* dump_run(void* arg) {
+    metrics* m = arg;
+    struct pollfd fds[2] = {
+        { .fd = m->wake[0], .events = POLLIN },
+        { .fd = m->listen_fd, .events = POLLIN },
+    };
+    uint64_t next = time_us() + m->interval_ms * 1000ULL;
+
+    for (;;) {
+        uint64_t now = time_us();
+        if (now >= next) {
+            metrics_sample(m);
+            if (m->listen_fd < 0)
+                dump_file(m);
+            next += m->interval_ms * 1000ULL;
+            if (next <= now)
+                next = now + m->interval_ms * 1000ULL;
+            continue;
+        }
+
+        poll(fds, m->listen_fd < 0 ? 1 : 2, (next - now + 999) / 1000);
+        if (fds[0].revents)
+            break;
+        if (m->listen_fd >= 0 && fds[1].revents)
+            dump_client(m);
+    }
+    return NULL;
+}
+
+static int listen_unix(const char* path) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(addr.sun_path))
+        return -1;
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    unlink(path);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 8) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ * samples every interval_ms on a background thread. a target of the
+ * form unix:path is a socket that answers every connection with the
+ * last sample, any other target is a file rewritten after each sample
+ * */
+uint8_t metrics_dump_start(metrics* m, const char* target, uint32_t interval_ms, uint8_t format) {
+    if (m->dumping || interval_ms == 0)
+        return 1;
+
+    m->listen_fd = -1;
+    if (!strncmp(target, METRICS_SOCKET_PREFIX, strlen(METRICS_SOCKET_PREFIX))) {
+        target += strlen(METRICS_SOCKET_PREFIX);
+        m->listen_fd = listen_unix(target);
+        if (m->listen_fd < 0)
+            return 1;
+    }
+    if (pipe(m->wake) != 0) {
+        if (m->listen_fd >= 0)
+            close(m->listen_fd);
+        m->listen_fd = -1;
+        return 1;
+    }
+
+    m->path = strdup(target);
+    m->format = format;
+    m->interval_ms = interval_ms;
+    m->dumping = 1;
+    pthread_create(&m->thread, NULL, dump_run, m);
+    return 0;
+}
+
+void metrics_dump_stop(metrics* m) {
+    if (!m->dumping)
+        return;
+    if (write(m->wake[1], "", 1) != 1)
+        perror("metrics");
+    pthread_join(m->thread, NULL);
+
+    close(m->wake[0]);
+    close(m->wake[1]);
+    if (m->listen_fd >= 0) {
+        close(m->listen_fd);
+        unlink(m->path);
+        m->listen_fd = -1;
+    }
+    free(m->path);
+    m->path = NULL;
+    m->dumping = 0;
+}
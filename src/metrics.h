@@ -0,0 +1,88 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "chip8.h"
+
+#define METRICS_TEXT 0
+#define METRICS_JSON 1
+
+#define METRICS_NAME_SIZE 64
+
+/*
+ * per-instance performance counters
+ *
+ * every counter has a single writer, so it is bumped with a plain load
+ * and a relaxed store instead of a locked add, and readers on other
+ * threads use relaxed loads. the block is allocated on its own cache
+ * lines and the counters written by the emulating thread and by the
+ * thread presenting frames are on separate lines, so the only cache
+ * traffic is from readers aggregating on demand
+ * */
+struct chip8_counters_t {
+    /* written by the thread running the instance */
+    uint64_t instructions __attribute__((aligned(64)));
+    uint64_t draws;
+    uint64_t clears;
+    uint64_t timer_ticks;     /* cycles in which the delay or sound timer ran */
+    uint64_t halts;
+    uint64_t errors[NUM_ERRORS]; /* chip8_error calls, by ERR_* */
+
+    /* written by the thread presenting frames */
+    uint64_t frames __attribute__((aligned(64)));
+    uint64_t inputs;          /* key events seen on screen, see input.h */
+    uint64_t input_latency_us; /* summed over those events */
+};
+typedef struct chip8_counters_t chip8_counters;
+
+static inline void counter_add(uint64_t* counter, uint64_t n) {
+    __atomic_store_n(counter, *counter + n, __ATOMIC_RELAXED);
+}
+
+static inline uint64_t counter_get(const uint64_t* counter) {
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+struct metrics_entry_t {
+    char     name[METRICS_NAME_SIZE];
+    chip8*   c;
+    chip8_counters now, last; /* at the last two samples */
+    double   mips, fps;       /* between the last two samples */
+};
+typedef struct metrics_entry_t metrics_entry;
+
+/*
+ * registry of the instances to report, sampled on demand or by a
+ * dump thread that rewrites a file or serves a unix socket
+ * */
+struct metrics_t {
+    pthread_mutex_t lock;
+    metrics_entry*  entries;
+    uint32_t        num_entries, max_entries;
+    uint64_t        sample_us;
+
+    pthread_t       thread;
+    uint8_t         dumping;
+    uint8_t         format;
+    uint32_t        interval_ms;
+    char*           path;
+    int             listen_fd;    /* -1 when dumping to a file */
+    int             wake[2];      /* written to stop the dump thread */
+};
+typedef struct metrics_t metrics;
+
+void     counters_read(const chip8_counters* src, chip8_counters* dst);
+
+metrics* metrics_init();
+void     metrics_free(metrics* m);
+void     metrics_register(metrics* m, const char* name, chip8* c);
+void     metrics_unregister(metrics* m, chip8* c);
+void     metrics_sample(metrics* m);
+void     metrics_total(metrics* m, chip8_counters* total);
+void     metrics_write(metrics* m, FILE* f, uint8_t format);
+uint8_t  metrics_dump_start(metrics* m, const char* target, uint32_t interval_ms, uint8_t format);
+void     metrics_dump_stop(metrics* m);
+
+#endif
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "chip8.h"
+#include "metrics.h"
 
 #define X ((c->opcode & 0x0F00) >> 8)
 #define Y ((c->opcode & 0x00F0) >> 4)
@@ -8,8 +9,6 @@
 #define KK (c->opcode & 0x00FF)
 #define ADDR (c->opcode & 0x0FFF)
 
-typedef void (*chip8_func_ptr)(chip8*);
-
 /*
  * stores Binary Coded Decimal (BCD)-representation of
  * Vx at in memory I, I+1 and I+2
@@ -24,44 +23,54 @@ void chip8_op_bcd(chip8* c, uint8_t x) {
 
 /*
  * stores registers V0-Vx in memory starting at I
+ * (QUIRK_LOAD_STORE_I leaves I pointing past the last byte)
  * */
-void chip8_op_store(chip8* c, uint8_t x) {
+static inline void chip8_op_store(chip8* c, uint8_t x, uint8_t quirks) {
     uint16_t index = chip8_index_get(c);
     for (uint8_t i=0; i<=x; i++)
         chip8_mem_write8(c, index+i, chip8_reg_get(c,i));
+    if (quirks & QUIRK_LOAD_STORE_I)
+        chip8_index_set(c, index + x + 1);
 }
 
 /*
  * load registers V0-Vx from memory starting at I
+ * (QUIRK_LOAD_STORE_I leaves I pointing past the last byte)
  * */
-void chip8_op_load(chip8* c, uint8_t x) {
+static inline void chip8_op_load(chip8* c, uint8_t x, uint8_t quirks) {
     uint16_t index = chip8_index_get(c);
     for (uint8_t i=0; i<=x; i++)
         chip8_reg_set(c,i, chip8_mem_read8(c, index+i));
+    if (quirks & QUIRK_LOAD_STORE_I)
+        chip8_index_set(c, index + x + 1);
 }
 
 void chip8_op_0xxx(chip8* c) {
 
-    if (KK == 0x00) {
+    if (c->opcode == 0x0000) {
         /* do nothing */
         chip8_pc_incr(c);
 
-    } else if (KK == 0xE0) {
+    } else if (c->opcode == 0x00E0) {
         /* clear screen */
+        counter_add(&c->counters->clears, 1);
         for (uint16_t i=0; i<WIDTH*HEIGHT; i++)
-            c->gfx[i] = 0;
+            if (c->gfx[i])
+                chip8_gfx_flip(c, i);
         chip8_pc_incr(c);
 
-    } else if (KK == 0xEE) {
-        /* return from subroutine or halt program */
+    } else if (c->opcode == 0x00EE) {
+        /* return from subroutine or halt program,
+         * the stack holds the address of the CALL */
         if (c->sp > 0) {
             chip8_stack_pop(c);
+            chip8_pc_incr(c);
         } else {
-            chip8_error(c, "halting program; restart required\n");
+            chip8_error(c, ERR_STACK_UNDERFLOW);
         }
 
     } else {
-        chip8_error(c, "invalid opcode [0x0000]: 0x%04X", c->opcode);
+        chip8_error(c, ERR_INVALID_OPCODE);
     }
 }
 
@@ -73,7 +82,7 @@ void chip8_op_1xxx(chip8* c) {
 void chip8_op_2xxx(chip8* c) {
     /* CALL ADDR */
     if (c->sp == STACK_SIZE) {
-        chip8_error(c, "stack overflow!");
+        chip8_error(c, ERR_STACK_OVERFLOW);
         return;
     }
     chip8_stack_push(c);
@@ -108,57 +117,77 @@ void chip8_op_6xxx(chip8* c) {
 }
 
 void chip8_op_7xxx(chip8* c) {
-    /* Vx = Vx + kk */
-    if (KK > 0xFF - chip8_reg_get(c,X))
-        chip8_reg_set(c, CARRY_REG, 1);
-    else
-        chip8_reg_set(c, CARRY_REG, 0);
+    /* Vx = Vx + kk, VF is not affected */
     chip8_reg_set(c,X, chip8_reg_get(c,X) + KK);
     chip8_pc_incr(c);
 }
 
-void chip8_op_8xxx(chip8* c) {
+/*
+ * the handlers below that depend on quirks are written once as inline
+ * templates and instantiated per quirk combination, so the quirk checks
+ * are resolved at compile time instead of on every instruction
+ * */
+static inline void chip8_op_8xxx_impl(chip8* c, uint8_t quirks) {
+    /* the shift source is Vy on the original interpreter, Vx on later ones */
+    uint8_t shift_src = (quirks & QUIRK_SHIFT_VY) ? Y : X;
+
+    /* operands are read before any write, VF is written last */
+    uint8_t Vx = chip8_reg_get(c,X);
+    uint8_t Vy = chip8_reg_get(c,Y);
+    uint8_t Vs = chip8_reg_get(c,shift_src);
+
     switch (N) {
         case 0x0000:
-            chip8_reg_set(c,X, chip8_reg_get(c,Y));
+            chip8_reg_set(c,X, Vy);
             break;
         case 0x0001:
-            chip8_reg_set(c,X, chip8_reg_get(c,X) & chip8_reg_get(c,Y));
+            chip8_reg_set(c,X, Vx & Vy);
+            if (quirks & QUIRK_VF_RESET)
+                chip8_reg_set(c,CARRY_REG, 0);
             break;
         case 0x0002:
-            chip8_reg_set(c,X, chip8_reg_get(c,X) | chip8_reg_get(c,Y));
+            chip8_reg_set(c,X, Vx | Vy);
+            if (quirks & QUIRK_VF_RESET)
+                chip8_reg_set(c,CARRY_REG, 0);
             break;
         case 0x0003:
-            chip8_reg_set(c,X, chip8_reg_get(c,X) ^ chip8_reg_get(c,Y));
+            chip8_reg_set(c,X, Vx ^ Vy);
+            if (quirks & QUIRK_VF_RESET)
+                chip8_reg_set(c,CARRY_REG, 0);
             break;
         case 0x0004:
-            chip8_reg_set(c,CARRY_REG,
-                    (chip8_reg_get(c,Y) > 0xFF - chip8_reg_get(c,X)) ? 1:0);
-            chip8_reg_set(c,X, chip8_reg_get(c,X) + chip8_reg_get(c,Y));
+            chip8_reg_set(c,X, Vx + Vy);
+            chip8_reg_set(c,CARRY_REG, (Vy > 0xFF - Vx) ? 1:0);
             break;
         case 0x0005:
-            chip8_reg_set(c,CARRY_REG,
-                    (chip8_reg_get(c,Y) > chip8_reg_get(c,X)) ? 1:0);
-            chip8_reg_set(c,X, chip8_reg_get(c,X) - chip8_reg_get(c,Y));
+            /* VF = NOT borrow */
+            chip8_reg_set(c,X, Vx - Vy);
+            chip8_reg_set(c,CARRY_REG, (Vx >= Vy) ? 1:0);
             break;
         case 0x0006:
-            chip8_reg_set(c,CARRY_REG, (chip8_reg_get(c,X) & 0x01) ? 1:0);
-            chip8_reg_set(c,X, chip8_reg_get(c,X) >> 1);
+            chip8_reg_set(c,X, Vs >> 1);
+            chip8_reg_set(c,CARRY_REG, (Vs & 0x01) ? 1:0);
             break;
         case 0x0007:
-            chip8_reg_set(c,CARRY_REG,
-                    (chip8_reg_get(c,X) > chip8_reg_get(c,Y)) ? 1:0);
-            chip8_reg_set(c,X, chip8_reg_get(c,Y) - chip8_reg_get(c,X));
+            chip8_reg_set(c,X, Vy - Vx);
+            chip8_reg_set(c,CARRY_REG, (Vy >= Vx) ? 1:0);
             break;
         case 0x000E:
-            chip8_reg_set(c,CARRY_REG, (chip8_reg_get(c,X) & 0x80) ? 1:0);
-            chip8_reg_set(c,X, chip8_reg_get(c,X) << 1);
+            chip8_reg_set(c,X, Vs << 1);
+            chip8_reg_set(c,CARRY_REG, (Vs & 0x80) ? 1:0);
             break;
-        default: chip8_error(c, "invalid opcode [0x8000]: 0x%04X", c->opcode); break;
+        default:
+            chip8_error(c, ERR_INVALID_OPCODE);
+            return;
     }
     chip8_pc_incr(c);
 }
 
+void chip8_op_8xxx(chip8* c)          { chip8_op_8xxx_impl(c, 0); }
+void chip8_op_8xxx_vy(chip8* c)       { chip8_op_8xxx_impl(c, QUIRK_SHIFT_VY); }
+void chip8_op_8xxx_vf(chip8* c)       { chip8_op_8xxx_impl(c, QUIRK_VF_RESET); }
+void chip8_op_8xxx_vy_vf(chip8* c)    { chip8_op_8xxx_impl(c, QUIRK_SHIFT_VY | QUIRK_VF_RESET); }
+
 void chip8_op_9xxx(chip8* c) {
     if (chip8_reg_get(c,X) != chip8_reg_get(c,Y))
         chip8_pc_incr(c);
@@ -171,44 +200,64 @@ void chip8_op_axxx(chip8* c) {
 }
 
 void chip8_op_bxxx(chip8* c) {
+    /* JMP V0 ADDR */
     chip8_pc_set(c, ADDR + chip8_reg_get(c,0));
 }
 
+void chip8_op_bxxx_vx(chip8* c) {
+    /* JMP Vx xnn */
+    chip8_pc_set(c, ADDR + chip8_reg_get(c,X));
+}
+
 void chip8_op_cxxx(chip8* c) {
     /* Vx = rand(0,255) & kk */
-    chip8_reg_set(c,X, (rand() % 0xFF) & KK);
+    chip8_reg_set(c,X, chip8_rand(c) & KK);
     chip8_pc_incr(c);
 }
 
-void chip8_op_dxxx(chip8* c) {
+static inline void chip8_op_dxxx_impl(chip8* c, uint8_t quirks) {
     /*
      * draws sprite at (x,y) of size n from
      * memory location I
      * VF = 1 if collision
+     * the start position always wraps around the screen, pixels
+     * beyond the edge either wrap too or are clipped (QUIRK_CLIP)
      * */
     uint8_t pixel;
-    uint8_t Vx = chip8_reg_get(c,X);
-    uint8_t Vy = chip8_reg_get(c,Y);
+    uint8_t Vx = chip8_reg_get(c,X) % WIDTH;
+    uint8_t Vy = chip8_reg_get(c,Y) % HEIGHT;
     uint16_t index = chip8_index_get(c);
 
     chip8_reg_set(c,CARRY_REG, 0);
     for (uint8_t yline=0; yline<N; yline++) {
 
-        pixel = c->memory[index + yline];
+        if ((quirks & QUIRK_CLIP) && Vy + yline >= HEIGHT)
+            break;
+        uint16_t row = ((Vy + yline) % HEIGHT) * WIDTH;
+
+        pixel = chip8_mem_read8(c, index + yline);
         for (uint8_t xline=0; xline<8; xline++) {
 
+            if ((quirks & QUIRK_CLIP) && Vx + xline >= WIDTH)
+                break;
+
             if ((pixel & (0x80>>xline)) != 0) {
+                uint16_t pos = row + (Vx + xline) % WIDTH;
 
-                if (c->gfx[(Vx + xline + ((Vy+yline)*WIDTH))] == 1)
+                if (c->gfx[pos] == 1)
                     chip8_reg_set(c,CARRY_REG,1);
-                c->gfx[(Vx + xline + ((Vy+yline)*WIDTH))] ^= 1;
+                chip8_gfx_flip(c, pos);
             }
         }
     }
     c->flags |= DRAW;
+    counter_add(&c->counters->draws, 1);
     chip8_pc_incr(c);
 }
 
+void chip8_op_dxxx(chip8* c)      { chip8_op_dxxx_impl(c, 0); }
+void chip8_op_dxxx_clip(chip8* c) { chip8_op_dxxx_impl(c, QUIRK_CLIP); }
+
 void chip8_op_exxx(chip8* c) {
     if (KK == 0x009E) {
 
@@ -223,29 +272,38 @@ void chip8_op_exxx(chip8* c) {
         chip8_pc_incr(c);
 
     } else {
-        chip8_error(c, "invalid opcode [0xE000]: 0x%04X", c->opcode);
+        chip8_error(c, ERR_INVALID_OPCODE);
     }
 }
 
-void chip8_op_fxxx(chip8* c) {
+static inline void chip8_op_fxxx_impl(chip8* c, uint8_t quirks) {
     switch (KK) {
         case 0x0007: chip8_reg_set(c,X, c->delay_timer); break;
-        case 0x000A: chip8_reg_set(c,X, chip8_wait_for_key(c)); break;
+        case 0x000A:
+            /* pc stays on Fx0A until a key is pressed */
+            if (!chip8_wait_for_key(c,X))
+                return;
+            break;
         case 0x0015: c->delay_timer = chip8_reg_get(c,X); break;
         case 0x0018: c->sound_timer = chip8_reg_get(c,X); break;
         case 0x001E: chip8_index_set(c, c->I + chip8_reg_get(c,X)); break;
         case 0x0029: chip8_index_set(c, chip8_char_get(c, chip8_reg_get(c,X))); break;
         case 0x0033: chip8_op_bcd(c,X); break;
-        case 0x0055: chip8_op_store(c,X); break;
-        case 0x0065: chip8_op_load(c,X); break;
-        default: chip8_error(c, "invalid opcode [0xF000]: 0x%04X", c->opcode); break;
+        case 0x0055: chip8_op_store(c,X,quirks); break;
+        case 0x0065: chip8_op_load(c,X,quirks); break;
+        default:
+            chip8_error(c, ERR_INVALID_OPCODE);
+            return;
     }
     chip8_pc_incr(c);
 }
 
+void chip8_op_fxxx(chip8* c)   { chip8_op_fxxx_impl(c, 0); }
+void chip8_op_fxxx_i(chip8* c) { chip8_op_fxxx_impl(c, QUIRK_LOAD_STORE_I); }
+
 
 
-chip8_func_ptr func_table[16] = {
+const chip8_func_ptr func_table[16] = {
     chip8_op_0xxx, chip8_op_1xxx, chip8_op_2xxx, chip8_op_3xxx,
     chip8_op_4xxx, chip8_op_5xxx, chip8_op_6xxx, chip8_op_7xxx,
     chip8_op_8xxx, chip8_op_9xxx, chip8_op_axxx, chip8_op_bxxx,
@@ -253,10 +311,32 @@ chip8_func_ptr func_table[16] = {
 };
 
 /*
- * sets opcode as specified by pc
+ * selects the handler variants matching a set of quirks,
+ * only the slots that have variants differ from func_table
+ * */
+void chip8_quirks_set(chip8* c, uint8_t quirks) {
+    for (uint8_t i=0; i<16; i++)
+        c->ops[i] = func_table[i];
+
+    switch (quirks & (QUIRK_SHIFT_VY | QUIRK_VF_RESET)) {
+        case QUIRK_SHIFT_VY:                  c->ops[0x8] = chip8_op_8xxx_vy; break;
+        case QUIRK_VF_RESET:                  c->ops[0x8] = chip8_op_8xxx_vf; break;
+        case QUIRK_SHIFT_VY | QUIRK_VF_RESET: c->ops[0x8] = chip8_op_8xxx_vy_vf; break;
+    }
+    if (quirks & QUIRK_JUMP_VX)      c->ops[0xB] = chip8_op_bxxx_vx;
+    if (quirks & QUIRK_CLIP)         c->ops[0xD] = chip8_op_dxxx_clip;
+    if (quirks & QUIRK_LOAD_STORE_I) c->ops[0xF] = chip8_op_fxxx_i;
+
+    c->quirks = quirks;
+}
+
+/*
+ * sets opcode as specified by pc,
+ * instruction fetches do not trigger watchpoints
  * */
 void chip8_opcode_fetch(chip8* c) {
-    c->opcode = chip8_mem_read16(c, c->pc);
+    uint16_t pc = chip8_pc_get(c);
+    c->opcode = c->memory[pc] << 8 | c->memory[(pc + 1) & MEM_MASK];
 }
 
 
@@ -265,7 +345,7 @@ void chip8_opcode_fetch(chip8* c) {
  * */
 void chip8_opcode_exec(chip8* c) {
 
-    chip8_func_ptr func = func_table[(c->opcode & 0xF000) >> 12];
+    chip8_func_ptr func = c->ops[(c->opcode & 0xF000) >> 12];
 
     func(c);
 
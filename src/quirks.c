@@ -0,0 +1,117 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "quirks.h"
+
+static const struct {
+    const char* name;
+    uint8_t     flag;
+} quirk_names[] = {
+    { "shift_vy",     QUIRK_SHIFT_VY },
+    { "load_store_i", QUIRK_LOAD_STORE_I },
+    { "jump_vx",      QUIRK_JUMP_VX },
+    { "clip",         QUIRK_CLIP },
+    { "vf_reset",     QUIRK_VF_RESET },
+};
+
+/*
+ * returns the flag for a quirk name, or 0 if unknown
+ * */
+uint8_t quirks_from_name(const char* name) {
+    for (size_t i=0; i<sizeof(quirk_names)/sizeof(quirk_names[0]); i++) {
+        if (strcmp(name, quirk_names[i].name) == 0)
+            return quirk_names[i].flag;
+    }
+    return 0;
+}
+
+static int quirks_entry_cmp(const void* a, const void* b) {
+    uint64_t ha = ((const quirks_entry*)a)->hash;
+    uint64_t hb = ((const quirks_entry*)b)->hash;
+    return (ha > hb) - (ha < hb);
+}
+
+/*
+ * load a quirks database, entries are kept sorted by hash
+ * */
+quirks_db* quirks_db_load(char* filename) {
+    FILE* f = fopen(filename, "r");
+    if (f == NULL) {
+        fprintf(stderr, "could not find \"%s\"\n", filename);
+        return NULL;
+    }
+
+    quirks_db* db = malloc(sizeof(quirks_db));
+    size_t capacity = 16;
+    db->entries = malloc(sizeof(quirks_entry) * capacity);
+    db->count = 0;
+
+    char line[256];
+    unsigned line_no = 0;
+    while (fgets(line, sizeof(line), f) != NULL) {
+        line_no++;
+
+        char* tok = strtok(line, " \t\r\n");
+        if (tok == NULL || tok[0] == '#')
+            continue;
+
+        char* end;
+        uint64_t hash = strtoull(tok, &end, 16);
+        if (*end != '\0') {
+            fprintf(stderr, "%s:%u: invalid hash \"%s\"\n", filename, line_no, tok);
+            continue;
+        }
+
+        uint8_t quirks = 0;
+        while ((tok = strtok(NULL, " \t\r\n")) != NULL && tok[0] != '#') {
+            uint8_t flag = quirks_from_name(tok);
+            if (flag == 0)
+                fprintf(stderr, "%s:%u: unknown quirk \"%s\"\n", filename, line_no, tok);
+            quirks |= flag;
+        }
+
+        if (db->count == capacity) {
+            capacity *= 2;
+            db->entries = realloc(db->entries, sizeof(quirks_entry) * capacity);
+        }
+        db->entries[db->count].hash = hash;
+        db->entries[db->count].quirks = quirks;
+        db->count++;
+    }
+    fclose(f);
+
+    qsort(db->entries, db->count, sizeof(quirks_entry), quirks_entry_cmp);
+    return db;
+}
+
+void quirks_db_free(quirks_db* db) {
+    if (db == NULL)
+        return;
+    free(db->entries);
+    free(db);
+}
+
+/*
+ * looks up the quirks for a rom hash, returns 1 if found
+ * */
+uint8_t quirks_db_lookup(quirks_db* db, uint64_t hash, uint8_t* quirks) {
+    quirks_entry key = { .hash = hash };
+    quirks_entry* e = bsearch(&key, db->entries, db->count,
+            sizeof(quirks_entry), quirks_entry_cmp);
+    if (e == NULL)
+        return 0;
+    *quirks = e->quirks;
+    return 1;
+}
+
+/*
+ * selects the handler variants for the loaded rom,
+ * roms missing from the database keep the default behaviour
+ * */
+uint8_t quirks_db_apply(quirks_db* db, chip8* c) {
+    uint8_t quirks = 0;
+    uint8_t found = quirks_db_lookup(db, c->rom_hash, &quirks);
+    chip8_quirks_set(c, quirks);
+    return found;
+}
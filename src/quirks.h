@@ -0,0 +1,38 @@
+#ifndef QUIRKS_H
+#define QUIRKS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "chip8.h"
+
+/*
+ * per-rom quirks database
+ *
+ * a plain text file with one rom per line, keyed by chip8_rom_hash:
+ *
+ *     # hash            quirks
+ *     9a1b2c3d4e5f6071  shift_vy load_store_i
+ *
+ * recognised quirk names are shift_vy, load_store_i, jump_vx,
+ * clip and vf_reset (see QUIRK_* in chip8.h)
+ * */
+
+struct quirks_entry_t {
+    uint64_t hash;
+    uint8_t  quirks;
+};
+typedef struct quirks_entry_t quirks_entry;
+
+struct quirks_db_t {
+    quirks_entry* entries;
+    size_t        count;
+};
+typedef struct quirks_db_t quirks_db;
+
+quirks_db* quirks_db_load(char* filename);
+void       quirks_db_free(quirks_db* db);
+uint8_t    quirks_db_lookup(quirks_db* db, uint64_t hash, uint8_t* quirks);
+uint8_t    quirks_db_apply(quirks_db* db, chip8* c);
+uint8_t    quirks_from_name(const char* name);
+
+#endif
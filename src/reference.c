@@ -0,0 +1,213 @@
+#include <stdint.h>
+#include <string.h>
+#include "reference.h"
+
+static void mem_set(ref* r, uint16_t addr, uint8_t val) {
+    addr &= MEM_MASK;
+    r->hash ^= chip8_hash_key(HASH_MEM + addr, r->mem[addr]) ^ chip8_hash_key(HASH_MEM + addr, val);
+    r->mem[addr] = val;
+}
+
+static void reg_set(ref* r, uint8_t x, uint8_t val) {
+    r->hash ^= chip8_hash_key(HASH_REG + x, r->V[x]) ^ chip8_hash_key(HASH_REG + x, val);
+    r->V[x] = val;
+}
+
+static void pixel_flip(ref* r, uint16_t pos) {
+    r->gfx[pos] ^= 1;
+    r->hash ^= chip8_hash_key(HASH_GFX + pos, 1);
+}
+
+static void push(ref* r, uint16_t addr) {
+    r->stack[r->sp] = addr;
+    r->hash ^= chip8_hash_key(HASH_STACK + r->sp, addr);
+    r->sp++;
+}
+
+static uint16_t pop(ref* r) {
+    r->sp--;
+    r->hash ^= chip8_hash_key(HASH_STACK + r->sp, r->stack[r->sp]);
+    return r->stack[r->sp];
+}
+
+static uint8_t next_random(ref* r) {
+    r->rng ^= r->rng << 13;
+    r->rng ^= r->rng >> 17;
+    r->rng ^= r->rng << 5;
+    return r->rng & 0xFF;
+}
+
+void ref_reset(ref* r, uint8_t quirks) {
+    memset(r, 0, sizeof(ref));
+    r->pc = PROGRAM_START;
+    r->quirks = quirks;
+    r->rng = RNG_SEED;
+    for (uint8_t i=0; i<CHARSET_SIZE; i++)
+        mem_set(r, CHARSET_START + i, font_charset[i]);
+}
+
+uint8_t ref_load(ref* r, const uint8_t* rom, size_t size) {
+    if (size > MEM_SIZE - PROGRAM_START)
+        return 1;
+    for (size_t i=0; i<size; i++)
+        mem_set(r, PROGRAM_START + i, rom[i]);
+    return 0;
+}
+
+static void draw(ref* r, uint8_t x, uint8_t y, uint8_t n) {
+    uint8_t x0 = r->V[x] % WIDTH;
+    uint8_t y0 = r->V[y] % HEIGHT;
+    uint8_t collision = 0;
+
+    for (uint8_t row=0; row<n; row++) {
+        uint8_t sprite = r->mem[(r->I + row) & MEM_MASK];
+        uint8_t py = y0 + row;
+        if (py >= HEIGHT) {
+            if (r->quirks & QUIRK_CLIP)
+                break;
+            py -= HEIGHT;
+        }
+        for (uint8_t col=0; col<8; col++) {
+            uint8_t px = x0 + col;
+            if (px >= WIDTH) {
+                if (r->quirks & QUIRK_CLIP)
+                    break;
+                px -= WIDTH;
+            }
+            if (sprite & (0x80 >> col)) {
+                if (r->gfx[py * WIDTH + px])
+                    collision = 1;
+                pixel_flip(r, py * WIDTH + px);
+            }
+        }
+    }
+    reg_set(r, 0xF, collision);
+}
+
+/*
+ * executes one instruction and ticks the timers once, like
+ * chip8_emulate_cycle. invalid instructions halt with pc on them
+ * */
+void ref_step(ref* r) {
+    if (r->halted)
+        return;
+
+    uint16_t op = r->mem[r->pc] << 8 | r->mem[(r->pc + 1) & MEM_MASK];
+    uint16_t nnn = op & 0x0FFF;
+    uint8_t  kk = op & 0xFF;
+    uint8_t  n = op & 0xF;
+    uint8_t  x = (op >> 8) & 0xF;
+    uint8_t  y = (op >> 4) & 0xF;
+    uint8_t  vx = r->V[x];
+    uint8_t  vy = r->V[y];
+    uint16_t next = r->pc + 2;
+
+    switch (op >> 12) {
+    case 0x0:
+        if (op == 0x00E0) {
+            for (uint16_t i=0; i<WIDTH*HEIGHT; i++)
+                if (r->gfx[i])
+                    pixel_flip(r, i);
+        } else if (op == 0x00EE) {
+            if (r->sp == 0) { r->halted = 1; break; }
+            next = pop(r) + 2;
+        } else if (op != 0x0000) {
+            /* 0nnn is unused, 0000 is treated as a no-op */
+            r->halted = 1;
+        }
+        break;
+    case 0x1: next = nnn; break;
+    case 0x2:
+        if (r->sp == STACK_SIZE) { r->halted = 1; break; }
+        push(r, r->pc);
+        next = nnn;
+        break;
+    case 0x3: if (vx == kk) next += 2; break;
+    case 0x4: if (vx != kk) next += 2; break;
+    case 0x5: if (vx == vy) next += 2; break;
+    case 0x6: reg_set(r, x, kk); break;
+    case 0x7: reg_set(r, x, vx + kk); break;
+    case 0x8: {
+        uint8_t vs = (r->quirks & QUIRK_SHIFT_VY) ? vy : vx;
+        uint8_t vf_reset = (r->quirks & QUIRK_VF_RESET) != 0;
+        /* VF is written after Vx, so it wins when x is F */
+        switch (n) {
+        case 0x0: reg_set(r, x, vy); break;
+        case 0x1: reg_set(r, x, vx & vy); if (vf_reset) reg_set(r, 0xF, 0); break;
+        case 0x2: reg_set(r, x, vx | vy); if (vf_reset) reg_set(r, 0xF, 0); break;
+        case 0x3: reg_set(r, x, vx ^ vy); if (vf_reset) reg_set(r, 0xF, 0); break;
+        case 0x4: reg_set(r, x, vx + vy); reg_set(r, 0xF, vx + vy > 0xFF); break;
+        /* VF is NOT borrow, so it is set when the operands are equal */
+        case 0x5: reg_set(r, x, vx - vy); reg_set(r, 0xF, vx >= vy); break;
+        case 0x6: reg_set(r, x, vs >> 1); reg_set(r, 0xF, vs & 1); break;
+        case 0x7: reg_set(r, x, vy - vx); reg_set(r, 0xF, vy >= vx); break;
+        case 0xE: reg_set(r, x, vs << 1); reg_set(r, 0xF, vs >> 7); break;
+        default:  r->halted = 1; break;
+        }
+        break;
+    }
+    case 0x9: if (vx != vy) next += 2; break;
+    case 0xA: r->I = nnn; break;
+    case 0xB: next = nnn + ((r->quirks & QUIRK_JUMP_VX) ? vx : r->V[0]); break;
+    case 0xC: reg_set(r, x, next_random(r) & kk); break;
+    case 0xD: draw(r, x, y, n); break;
+    case 0xE:
+        if (kk == 0x9E)      { if (r->keys[vx & 0xF])  next += 2; }
+        else if (kk == 0xA1) { if (!r->keys[vx & 0xF]) next += 2; }
+        else r->halted = 1;
+        break;
+    case 0xF:
+        switch (kk) {
+        case 0x07: reg_set(r, x, r->dt); break;
+        case 0x0A: {
+            uint8_t key = 0;
+            while (key < NUM_KEYS && !r->keys[key])
+                key++;
+            if (key == NUM_KEYS)
+                next = r->pc;
+            else
+                reg_set(r, x, key);
+            break;
+        }
+        case 0x15: r->dt = vx; break;
+        case 0x18: r->st = vx; break;
+        case 0x1E: r->I = (r->I + vx) & MEM_MASK; break;
+        case 0x29: r->I = CHARSET_START + (vx & 0xF) * BYTES_PER_CHAR; break;
+        case 0x33:
+            mem_set(r, r->I,     vx / 100);
+            mem_set(r, r->I + 1, vx / 10 % 10);
+            mem_set(r, r->I + 2, vx % 10);
+            break;
+        case 0x55:
+        case 0x65:
+            for (uint8_t i=0; i<=x; i++) {
+                if (kk == 0x55)
+                    mem_set(r, r->I + i, r->V[i]);
+                else
+                    reg_set(r, i, r->mem[(r->I + i) & MEM_MASK]);
+            }
+            if (r->quirks & QUIRK_LOAD_STORE_I)
+                r->I = (r->I + x + 1) & MEM_MASK;
+            break;
+        default: r->halted = 1; break;
+        }
+        break;
+    }
+
+    if (!r->halted)
+        r->pc = next & MEM_MASK;
+
+    /* the cycle that halts still ticks the timers */
+    if (r->dt > 0) r->dt--;
+    if (r->st > 0) r->st--;
+}
+
+/*
+ * same as chip8_state_hash for an interpreter in the same state
+ * */
+uint64_t ref_state_hash(ref* r) {
+    return r->hash
+        ^ chip8_hash_mix((uint64_t)r->pc | (uint64_t)r->I << 12 | (uint64_t)r->sp << 24
+                         | (uint64_t)r->dt << 32 | (uint64_t)r->st << 40)
+        ^ chip8_hash_mix((uint64_t)1 << 48 | r->rng);
+}
@@ -0,0 +1,35 @@
+#ifndef REFERENCE_H
+#define REFERENCE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "chip8.h"
+
+/*
+ * a deliberately simple second implementation of the instruction set,
+ * written from the table in README.md and the quirk descriptions rather
+ * than from opcode.c. it shares nothing with the interpreter except the
+ * constants, the hash keys and the xorshift32 generator behind Cxkk, so
+ * running both in lockstep (see c8diff.c) catches semantic changes
+ * */
+struct ref_t {
+    uint8_t  mem[MEM_SIZE];
+    uint8_t  V[NUM_REGS];
+    uint8_t  gfx[WIDTH * HEIGHT];
+    uint16_t stack[STACK_SIZE];
+    uint8_t  keys[NUM_KEYS];
+    uint16_t pc, I;
+    uint8_t  sp, dt, st;
+    uint8_t  quirks;
+    uint8_t  halted;
+    uint32_t rng;
+    uint64_t hash;      /* memory, V, gfx and live stack, same keys as chip8_t */
+};
+typedef struct ref_t ref;
+
+void    ref_reset(ref* r, uint8_t quirks);
+uint8_t ref_load(ref* r, const uint8_t* rom, size_t size);
+void    ref_step(ref* r);
+uint64_t ref_state_hash(ref* r);
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stdint.h>
+
+#define RING_SIZE 1024
+#define RING_MASK (RING_SIZE - 1)
+
+/*
+ * single-producer/single-consumer lock-free queue of 64-bit values
+ *
+ * head is only written by the producer and tail only by the consumer,
+ * each on its own cache line. neither side ever blocks, a push onto a
+ * full ring fails and the producer decides what to drop
+ * */
+struct ring_t {
+    uint32_t head __attribute__((aligned(64)));
+    uint32_t tail __attribute__((aligned(64)));
+    uint64_t buf[RING_SIZE] __attribute__((aligned(64)));
+};
+typedef struct ring_t ring;
+
+static inline void ring_init(ring* r) {
+    r->head = 0;
+    r->tail = 0;
+}
+
+static inline uint8_t ring_push(ring* r, uint64_t val) {
+    uint32_t head = r->head;
+    if (head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) == RING_SIZE)
+        return 0;
+    r->buf[head & RING_MASK] = val;
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+static inline uint8_t ring_peek(ring* r, uint64_t* val) {
+    uint32_t tail = r->tail;
+    if (tail == __atomic_load_n(&r->head, __ATOMIC_ACQUIRE))
+        return 0;
+    *val = r->buf[tail & RING_MASK];
+    return 1;
+}
+
+static inline void ring_drop(ring* r) {
+    __atomic_store_n(&r->tail, r->tail + 1, __ATOMIC_RELEASE);
+}
+
+static inline uint8_t ring_pop(ring* r, uint64_t* val) {
+    if (!ring_peek(r, val))
+        return 0;
+    ring_drop(r);
+    return 1;
+}
+
+#endif
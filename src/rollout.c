@@ -0,0 +1,144 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include "rollout.h"
+
+/*
+ * runs the frames of a job on c, which already holds the start state,
+ * and stops early if the rom halts
+ * */
+void rollout_play(chip8* c, rollout_job* job, uint32_t cycles_per_frame) {
+    uint64_t start = c->cycles;
+    for (uint32_t f=0; f<job->frames && !chip8_check_flag(c, HALT); f++) {
+        uint16_t keys = job->keys[f];
+        for (uint8_t k=0; k<NUM_KEYS; k++)
+            chip8_key_set(c, k, (keys >> k) & 1);
+        for (uint32_t i=0; i<cycles_per_frame && !chip8_check_flag(c, HALT); i++)
+            chip8_emulate_cycle(c);
+    }
+    job->halted = chip8_check_flag(c, HALT) != 0;
+    job->cycles = c->cycles - start;
+}
+
+static void* worker(void* arg) {
+    rollout_pool* p = arg;
+    /* allocated here so the instance is first touched by the thread using it */
+    chip8* c = chip8_init();
+    uint64_t seen = 0;
+
+    pthread_mutex_lock(&p->lock);
+    p->started++;
+    if (c == NULL)
+        p->failed = 1;
+    pthread_cond_signal(&p->done);
+    if (c == NULL) {
+        pthread_mutex_unlock(&p->lock);
+        return NULL;
+    }
+    for (;;) {
+        while (p->generation == seen && !p->stop)
+            pthread_cond_wait(&p->start, &p->lock);
+        if (p->stop)
+            break;
+        seen = p->generation;
+        pthread_mutex_unlock(&p->lock);
+
+        for (;;) {
+            uint32_t i = __atomic_fetch_add(&p->next, p->chunk, __ATOMIC_RELAXED);
+            if (i >= p->num_jobs)
+                break;
+            uint32_t end = i + p->chunk < p->num_jobs ? i + p->chunk : p->num_jobs;
+            for (; i<end; i++) {
+                rollout_job* job = &p->jobs[i];
+                chip8_clone(c, p->origin);
+                rollout_play(c, job, p->cfg.cycles_per_frame);
+                job->score = p->cfg.score ? p->cfg.score(c, p->cfg.user) : 0;
+            }
+        }
+
+        pthread_mutex_lock(&p->lock);
+        if (--p->active == 0)
+            pthread_cond_signal(&p->done);
+    }
+    pthread_mutex_unlock(&p->lock);
+
+    chip8_free(c);
+    return NULL;
+}
+
+rollout_pool* rollout_pool_init(const rollout_config* cfg) {
+    rollout_pool* p = calloc(1, sizeof(rollout_pool));
+    if (p == NULL)
+        return NULL;
+    p->cfg = *cfg;
+    if (p->cfg.cycles_per_frame == 0)
+        p->cfg.cycles_per_frame = ROLLOUT_CYCLES_PER_FRAME;
+
+    p->num_workers = cfg->workers;
+    if (p->num_workers < 1) p->num_workers = 1;
+    if (p->num_workers > ROLLOUT_MAX_WORKERS) p->num_workers = ROLLOUT_MAX_WORKERS;
+
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->start, NULL);
+    pthread_cond_init(&p->done, NULL);
+    uint32_t num_workers = p->num_workers;
+    for (uint32_t i=0; i<num_workers; i++) {
+        if (pthread_create(&p->threads[i], NULL, worker, p) != 0) {
+            /* only the threads created so far are joined */
+            p->num_workers = i;
+            p->failed = 1;
+            break;
+        }
+    }
+
+    /* wait for every worker to allocate its instance before the first batch */
+    pthread_mutex_lock(&p->lock);
+    while (p->started < p->num_workers)
+        pthread_cond_wait(&p->done, &p->lock);
+    uint8_t failed = p->failed;
+    pthread_mutex_unlock(&p->lock);
+    if (failed) {
+        rollout_pool_free(p);
+        return NULL;
+    }
+    return p;
+}
+
+void rollout_pool_free(rollout_pool* p) {
+    pthread_mutex_lock(&p->lock);
+    p->stop = 1;
+    pthread_cond_broadcast(&p->start);
+    pthread_mutex_unlock(&p->lock);
+    for (uint32_t i=0; i<p->num_workers; i++)
+        pthread_join(p->threads[i], NULL);
+
+    pthread_cond_destroy(&p->start);
+    pthread_cond_destroy(&p->done);
+    pthread_mutex_destroy(&p->lock);
+    free(p);
+}
+
+/*
+ * runs every job from a clone of origin and blocks until all are
+ * scored. origin is only read, it must not change during the call
+ * */
+void rollout_run(rollout_pool* p, const chip8* origin, rollout_job* jobs, uint32_t num_jobs) {
+    if (num_jobs == 0)
+        return;
+
+    pthread_mutex_lock(&p->lock);
+    p->origin = origin;
+    p->jobs = jobs;
+    p->num_jobs = num_jobs;
+    /* a few chunks per worker keeps the index cold without losing balance */
+    p->chunk = num_jobs / (p->num_workers * 8);
+    if (p->chunk == 0)
+        p->chunk = 1;
+    p->next = 0;
+    p->active = p->num_workers;
+    p->generation++;
+    pthread_cond_broadcast(&p->start);
+
+    while (p->active > 0)
+        pthread_cond_wait(&p->done, &p->lock);
+    pthread_mutex_unlock(&p->lock);
+}
@@ -0,0 +1,66 @@
+#ifndef ROLLOUT_H
+#define ROLLOUT_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include "chip8.h"
+
+#define ROLLOUT_MAX_WORKERS 64
+#define ROLLOUT_CYCLES_PER_FRAME 16
+
+/*
+ * one headless run from a common start state: keys[f] holds the keys
+ * down during frame f as a bit mask. frames, score, halted and cycles
+ * are filled in when it has run
+ * */
+struct rollout_job_t {
+    const uint16_t* keys;
+    uint32_t frames;
+    int64_t  score;
+    uint8_t  halted;
+    uint64_t cycles;
+};
+typedef struct rollout_job_t rollout_job;
+
+struct rollout_config_t {
+    uint32_t workers;
+    uint32_t cycles_per_frame;    /* 0 for ROLLOUT_CYCLES_PER_FRAME */
+    /* called on the worker thread once the run ends, reads V, memory, gfx */
+    int64_t  (*score)(chip8* c, void* user);
+    void*    user;
+};
+typedef struct rollout_config_t rollout_config;
+
+/*
+ * persistent worker threads, each with its own instance that every job
+ * it takes is cloned into. a batch is handed out in chunks through an
+ * atomic index and rollout_run returns once all of it has run.
+ * rollout_pool_init returns NULL if a thread or an instance could not
+ * be created
+ * */
+struct rollout_pool_t {
+    rollout_config  cfg;
+    pthread_t       threads[ROLLOUT_MAX_WORKERS];
+    uint32_t        num_workers;
+
+    pthread_mutex_t lock;
+    pthread_cond_t  start, done;
+    uint64_t        generation;   /* bumped for every batch */
+    uint32_t        active;       /* workers still on the batch */
+    uint32_t        started;      /* workers done setting up, see failed */
+    uint8_t         failed;       /* a worker could not allocate its instance */
+    uint8_t         stop;
+
+    const chip8*    origin;
+    rollout_job*    jobs;
+    uint32_t        num_jobs, chunk;
+    uint32_t        next;         /* taken with an atomic add by the workers */
+};
+typedef struct rollout_pool_t rollout_pool;
+
+rollout_pool* rollout_pool_init(const rollout_config* cfg);
+void          rollout_pool_free(rollout_pool* p);
+void          rollout_run(rollout_pool* p, const chip8* origin, rollout_job* jobs, uint32_t num_jobs);
+void          rollout_play(chip8* c, rollout_job* job, uint32_t cycles_per_frame);
+
+#endif
@@ -0,0 +1,145 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include "state.h"
+
+/* 0 marks empty slots, so a state hashing to 0 is stored as 1 */
+#define SLOT_KEY(h) ((h) ? (h) : 1)
+
+state_set* state_set_init(uint32_t capacity) {
+    uint32_t size = 16;
+    while (size < capacity * 2)
+        size <<= 1;
+
+    state_set* s = malloc(sizeof(state_set));
+    if (s == NULL)
+        return NULL;
+    s->slots = calloc(size, sizeof(uint64_t));
+    if (s->slots == NULL) {
+        free(s);
+        return NULL;
+    }
+    s->mask = size - 1;
+    s->count = 0;
+    return s;
+}
+
+void state_set_free(state_set* s) {
+    free(s->slots);
+    free(s);
+}
+
+static uint64_t* state_set_find(uint64_t* slots, uint32_t mask, uint64_t key) {
+    uint32_t i = key & mask;
+    while (slots[i] != 0 && slots[i] != key)
+        i = (i + 1) & mask;
+    return &slots[i];
+}
+
+/* doubles the table, returns 1 if the new one cannot be allocated */
+static uint8_t state_set_grow(state_set* s) {
+    uint32_t mask = s->mask * 2 + 1;
+    uint64_t* slots = calloc(mask + 1, sizeof(uint64_t));
+    if (slots == NULL)
+        return 1;
+    for (uint32_t i=0; i<=s->mask; i++)
+        if (s->slots[i] != 0)
+            *state_set_find(slots, mask, s->slots[i]) = s->slots[i];
+    free(s->slots);
+    s->slots = slots;
+    s->mask = mask;
+    return 0;
+}
+
+/*
+ * returns 1 if the state was not in the set yet, 0 if it was and -1 if
+ * the set is half full and cannot grow, the state is not added then
+ * */
+int8_t state_set_insert(state_set* s, uint64_t hash) {
+    uint64_t key = SLOT_KEY(hash);
+    uint64_t* slot = state_set_find(s->slots, s->mask, key);
+    if (*slot == key)
+        return 0;
+    if ((s->count + 1) * 2 > s->mask) {
+        if (state_set_grow(s) != 0)
+            return -1;
+        slot = state_set_find(s->slots, s->mask, key);
+    }
+    *slot = key;
+    s->count++;
+    return 1;
+}
+
+/*
+ * insert that can be called from several threads at once, slots are
+ * claimed with a compare and swap. the set does not grow, so it has to
+ * be created with enough capacity. once it holds `capacity` states
+ * further inserts are dropped and return 0, see state_set_full
+ * */
+uint8_t state_set_insert_atomic(state_set* s, uint64_t hash) {
+    uint64_t key = SLOT_KEY(hash);
+    uint32_t i = key & s->mask;
+    for (;;) {
+        uint64_t cur = __atomic_load_n(&s->slots[i], __ATOMIC_ACQUIRE);
+        if (cur == key)
+            return 0;
+        if (cur == 0) {
+            if (__atomic_add_fetch(&s->count, 1, __ATOMIC_RELAXED) * 2 > s->mask) {
+                __atomic_sub_fetch(&s->count, 1, __ATOMIC_RELAXED);
+                return 0;
+            }
+            if (__atomic_compare_exchange_n(&s->slots[i], &cur, key, 0,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+                return 1;
+            __atomic_sub_fetch(&s->count, 1, __ATOMIC_RELAXED);
+            if (cur == key)
+                return 0;
+        }
+        i = (i + 1) & s->mask;
+    }
+}
+
+uint8_t state_set_contains(state_set* s, uint64_t hash) {
+    uint64_t key = SLOT_KEY(hash);
+    return *state_set_find(s->slots, s->mask, key) == key;
+}
+
+void loop_detect_init(loop_detect* l, uint64_t hash) {
+    l->saved = hash;
+    l->power = 1;
+    l->length = 0;
+}
+
+/*
+ * feeds the next state, returns the period once the sequence is found
+ * to repeat and 0 before that
+ * */
+uint64_t loop_detect_step(loop_detect* l, uint64_t hash) {
+    l->length++;
+    if (hash == l->saved)
+        return l->length;
+    if (l->length == l->power) {
+        l->saved = hash;
+        l->power <<= 1;
+        l->length = 0;
+    }
+    return 0;
+}
+
+/*
+ * runs until the program provably loops forever with the current key
+ * states, returns the period of the loop or 0 if it halted or no loop
+ * was found within max_cycles
+ * */
+uint64_t chip8_loop_find(chip8* c, uint64_t max_cycles) {
+    loop_detect l;
+    loop_detect_init(&l, chip8_state_hash(c));
+    for (uint64_t i=0; i<max_cycles; i++) {
+        chip8_emulate_cycle(c);
+        if (chip8_check_flag(c, HALT))
+            return 0;
+        uint64_t period = loop_detect_step(&l, chip8_state_hash(c));
+        if (period != 0)
+            return period;
+    }
+    return 0;
+}
@@ -0,0 +1,44 @@
+#ifndef STATE_H
+#define STATE_H
+
+#include <stdint.h>
+#include "chip8.h"
+
+/*
+ * helpers on top of chip8_state_hash: a set of seen states for
+ * deduplication and cycle detection on the sequence of states
+ * */
+
+struct state_set_t {
+    uint64_t* slots;        /* open addressing, 0 marks an empty slot */
+    uint32_t  mask;
+    uint32_t  count;
+};
+typedef struct state_set_t state_set;
+
+state_set* state_set_init(uint32_t capacity);
+void       state_set_free(state_set* s);
+int8_t     state_set_insert(state_set* s, uint64_t hash);
+uint8_t    state_set_contains(state_set* s, uint64_t hash);
+uint8_t    state_set_insert_atomic(state_set* s, uint64_t hash);
+
+static inline uint8_t state_set_full(state_set* s) {
+    return (__atomic_load_n(&s->count, __ATOMIC_RELAXED) + 1) * 2 > s->mask;
+}
+
+/*
+ * Brent's cycle detection, constant memory and one comparison per step.
+ * the state hash leaves out the keys, so a loop is only meaningful while
+ * the key states stay the same
+ * */
+struct loop_detect_t {
+    uint64_t saved;
+    uint64_t power, length;
+};
+typedef struct loop_detect_t loop_detect;
+
+void     loop_detect_init(loop_detect* l, uint64_t hash);
+uint64_t loop_detect_step(loop_detect* l, uint64_t hash);
+uint64_t chip8_loop_find(chip8* c, uint64_t max_cycles);
+
+#endif
@@ -0,0 +1,126 @@
+#include <string.h>
+#include <unistd.h>
+#include "test_chip8.h"
+#include "../src/analyze.h"
+#include "../src/asm.h"
+
+static chip8* c;
+static asm_error err;
+
+static const char* program =
+    "    LD I .SPRITE\n"        /* 0x200 */
+    ".LOOP\n"
+    "    CALL .DRAW\n"          /* 0x202 */
+    "    SEQ V0 0x00\n"         /* 0x204 */
+    "    JMP .LOOP\n"           /* 0x206 */
+    "    JMP V0 0x300\n"        /* 0x208 */
+    ".DRAW\n"
+    "    DRAW V1 V2 0x3\n"      /* 0x20A */
+    "    SKP V0\n"              /* 0x20C */
+    "    RET\n"                 /* 0x20E */
+    "    RET\n"                 /* 0x210 */
+    ".SPRITE\n"
+    "    DB 0xF0 0x90 0xF0\n";  /* 0x212 */
+
+static void setup() {
+    c = chip8_init();
+    ck_assert_uint_eq(chip8_asm_load(c, program, strlen(program), &err), 0);
+}
+static void teardown() {
+    chip8_free(c);
+}
+
+START_TEST(test_analyze_code_map) {
+    analysis* a = chip8_analyze(c);
+
+    for (uint16_t addr=0x200; addr<0x212; addr++)
+        ck_assert_msg(analysis_is_code(a, addr), "0x%03X is code", addr);
+    for (uint16_t addr=0x212; addr<0x215; addr++)
+        ck_assert_msg(!analysis_is_code(a, addr), "0x%03X is data", addr);
+    ck_assert_uint_eq((a->data_ref[0x212 >> 3] >> (0x212 & 7)) & 1, 1);
+
+    ck_assert_uint_eq(a->num_indirect, 1);
+    ck_assert_uint_eq(a->indirect[0].site, 0x208);
+    ck_assert_uint_eq(a->indirect[0].base, 0x300);
+
+    analysis_free(a);
+} END_TEST
+
+START_TEST(test_analyze_blocks) {
+    analysis* a = chip8_analyze(c);
+    block* b;
+
+    /* 0x200 0x202 0x204 0x206 0x208 0x20A 0x20E 0x210 */
+    ck_assert_uint_eq(a->num_blocks, 8);
+
+    b = analysis_block_find(a, 0x202);
+    ck_assert(b != NULL);
+    ck_assert_uint_eq(b->end, 0x204);
+    ck_assert_uint_eq(b->flags, BLOCK_CALL);
+    ck_assert_uint_eq(b->succ[0], 0x20A);
+    ck_assert_uint_eq(b->succ[1], 0x204);
+
+    b = analysis_block_find(a, 0x204);
+    ck_assert_uint_eq(b->num_succ, 2);
+    ck_assert_uint_eq(b->succ[1], 0x208);
+
+    b = analysis_block_find(a, 0x20A);
+    ck_assert_uint_eq(b->end, 0x20E);
+    ck_assert_uint_eq(b->flags, BLOCK_SUBROUTINE);
+    ck_assert_uint_eq(b->subroutine, 1);
+    ck_assert_uint_eq(analysis_block_find(a, 0x210)->subroutine, 1);
+    ck_assert_uint_eq(analysis_block_find(a, 0x210)->flags, BLOCK_RETURN);
+    ck_assert_uint_eq(analysis_block_find(a, 0x204)->subroutine, 0);
+
+    ck_assert_uint_eq(analysis_block_find(a, 0x208)->flags, BLOCK_INDIRECT);
+    ck_assert_uint_eq(a->num_subroutines, 1);
+    ck_assert_uint_eq(a->subroutines[0], 0x20A);
+
+    analysis_free(a);
+} END_TEST
+
+START_TEST(test_analyze_cache) {
+    char dir[] = "/tmp/test_analyze_XXXXXX";
+    ck_assert(mkdtemp(dir) != NULL);
+
+    ck_assert(analysis_load(dir, c->rom_hash, c->quirks) == NULL);
+    analysis* a = chip8_analyze_cached(c, dir);
+    analysis* b = analysis_load(dir, c->rom_hash, c->quirks);
+    ck_assert(b != NULL);
+    ck_assert(memcmp(a, b, sizeof(analysis)) == 0);
+    ck_assert(analysis_load(dir, c->rom_hash, QUIRK_CLIP) == NULL);
+
+    /* a corrupt or stale cache file is treated as missing */
+    b->num_blocks = MAX_BLOCKS + 1;
+    ck_assert_uint_eq(analysis_save(b, dir), 0);
+    ck_assert(analysis_load(dir, c->rom_hash, c->quirks) == NULL);
+    memcpy(b, a, sizeof(analysis));
+    b->blocks[0].num_succ = 3;
+    ck_assert_uint_eq(analysis_save(b, dir), 0);
+    ck_assert(analysis_load(dir, c->rom_hash, c->quirks) == NULL);
+    memcpy(b, a, sizeof(analysis));
+    b->version = ANALYSIS_VERSION + 1;
+    ck_assert_uint_eq(analysis_save(b, dir), 0);
+    ck_assert(analysis_load(dir, c->rom_hash, c->quirks) == NULL);
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%016lx-%02x.cfg", dir, (unsigned long)c->rom_hash, c->quirks);
+    unlink(path);
+    rmdir(dir);
+    analysis_free(a);
+    analysis_free(b);
+} END_TEST
+
+Suite* analyze_suite(void) {
+
+    TCase* tc_core = tcase_create("core");
+    tcase_add_checked_fixture(tc_core, setup, teardown);
+    tcase_add_test(tc_core, test_analyze_code_map);
+    tcase_add_test(tc_core, test_analyze_blocks);
+    tcase_add_test(tc_core, test_analyze_cache);
+
+    Suite* s = suite_create("analyze");
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
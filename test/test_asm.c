@@ -0,0 +1,97 @@
+#include <string.h>
+#include "test_chip8.h"
+#include "../src/asm.h"
+#include "../src/disasm.h"
+
+static uint8_t rom[MEM_SIZE - PROGRAM_START];
+static size_t size;
+static asm_error err;
+
+#define ASSEMBLE(src) chip8_asm((src), strlen(src), rom, sizeof(rom), &size, &err)
+
+START_TEST(test_asm_labels) {
+    const char* src =
+        "; forward and backward references\n"
+        "  ld i .sprite\n"
+        ".LOOP\n"
+        "  DRAW V0 V1 0x3  ; comment\n"
+        "  CALL .sub\n"
+        "  JMP .loop\n"
+        ".SUB RET\n"
+        ".SPRITE\n"
+        "  DB 0xF0 0x90 0xF0\n"
+        "  DW .LOOP 0x1234\n";
+
+    ck_assert_uint_eq(ASSEMBLE(src), 0);
+    ck_assert_uint_eq(size, 17);
+
+    uint8_t expected[] = {
+        0xA2, 0x0A, 0xD0, 0x13, 0x22, 0x08, 0x12, 0x02, 0x00, 0xEE,
+        0xF0, 0x90, 0xF0, 0x02, 0x02, 0x12, 0x34
+    };
+    ck_assert(memcmp(rom, expected, sizeof(expected)) == 0);
+
+} END_TEST
+
+START_TEST(test_asm_errors) {
+
+    ck_assert_uint_eq(ASSEMBLE("LD V0 0x00\nFOO V0\n"), 1);
+    ck_assert_uint_eq(err.line, 2);
+
+    ck_assert_uint_eq(ASSEMBLE("JMP .NOWHERE\n"), 1);
+    ck_assert_uint_eq(ASSEMBLE(".A\n.A\n"), 1);
+    ck_assert_uint_eq(ASSEMBLE("LD V0 0x100\n"), 1);
+    ck_assert_uint_eq(ASSEMBLE("DRAW V0 V1\n"), 1);
+    ck_assert_uint_eq(ASSEMBLE("JMP V1 0x200\n"), 1);
+    ck_assert_uint_eq(ASSEMBLE("DB 0x100\n"), 1);
+
+    /* a label after a full rom is at 0x1000 */
+    static char full[16 + (MEM_SIZE - PROGRAM_START) * 5];
+    strcpy(full, "JMP .END\n");
+    for (uint16_t i=2; i<MEM_SIZE - PROGRAM_START; i++)
+        strcat(full, "DB 0\n");
+    strcat(full, ".END\n");
+    ck_assert_uint_eq(ASSEMBLE(full), 1);
+    ck_assert_uint_eq(err.line, 1);
+
+} END_TEST
+
+/* everything the disassembler prints assembles back to the same word */
+START_TEST(test_asm_disasm_roundtrip) {
+    char buf[32];
+
+    for (uint32_t op=0; op<=0xFFFF; op++) {
+        chip8_disasm(op, buf, sizeof(buf));
+        ck_assert_msg(ASSEMBLE(buf) == 0, "%s: %s", buf, err.message);
+        ck_assert_uint_eq(size, 2);
+        ck_assert_uint_eq(rom[0] << 8 | rom[1], op);
+    }
+
+} END_TEST
+
+START_TEST(test_asm_load) {
+    chip8* c = chip8_init();
+    const char* src = "LD V0 0x05\nADD V0 0x01\n";
+
+    ck_assert_uint_eq(chip8_asm_load(c, src, strlen(src), &err), 0);
+    ck_assert_uint_ne(c->rom_hash, 0);
+    chip8_emulate_cycle(c);
+    chip8_emulate_cycle(c);
+    ASSERT_REG(0, 0x06)
+
+    chip8_free(c);
+} END_TEST
+
+Suite* asm_suite(void) {
+
+    TCase* tc_core = tcase_create("core");
+    tcase_add_test(tc_core, test_asm_labels);
+    tcase_add_test(tc_core, test_asm_errors);
+    tcase_add_test(tc_core, test_asm_disasm_roundtrip);
+    tcase_add_test(tc_core, test_asm_load);
+
+    Suite* s = suite_create("asm");
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
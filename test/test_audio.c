@@ -0,0 +1,84 @@
+#include "test_chip8.h"
+#include "../src/audio.h"
+
+static chip8* c;
+static audio* a;
+static void setup() {
+    c = chip8_init();
+    /* 1 cycle == 8 samples */
+    a = audio_init(8000, 1000);
+    audio_attach(a, c);
+}
+static void teardown() {
+    audio_free(a);
+    chip8_free(c);
+}
+
+START_TEST(test_audio_ring) {
+    ring* r = &a->events;
+    uint64_t val;
+
+    ck_assert_uint_eq(ring_pop(r, &val), 0);
+    for (uint32_t i=0; i<RING_SIZE; i++)
+        ck_assert_uint_eq(ring_push(r, i), 1);
+    ck_assert_uint_eq(ring_push(r, RING_SIZE), 0);
+
+    for (uint32_t i=0; i<RING_SIZE; i++) {
+        ck_assert_uint_eq(ring_pop(r, &val), 1);
+        ck_assert_uint_eq(val, i);
+    }
+    ck_assert_uint_eq(ring_pop(r, &val), 0);
+
+} END_TEST
+
+/* transitions land on the sample matching their cycle */
+START_TEST(test_audio_render) {
+    int16_t out[100];
+
+    ring_push(&a->events, 2 << 1 | 1);
+    ring_push(&a->events, 10 << 1 | 0);
+    audio_render(a, out, 100);
+
+    for (uint32_t i=0; i<100; i++) {
+        if (i < 16 || i >= 80)
+            ck_assert_int_eq(out[i], 0);
+        else
+            ck_assert_int_ne(out[i], 0);
+    }
+    ck_assert_uint_eq(a->sample_pos, 100);
+
+} END_TEST
+
+/* the sound timer publishes on/off transitions with their cycle */
+START_TEST(test_audio_sound_timer) {
+    uint64_t val;
+
+    /* LD V0 0x03; LD ST V0; JMP 0x204 */
+    chip8_mem_write16(c, 0x200, 0x6003);
+    chip8_mem_write16(c, 0x202, 0xf018);
+    chip8_mem_write16(c, 0x204, 0x1204);
+
+    for (uint8_t i=0; i<10; i++)
+        chip8_emulate_cycle(c);
+
+    ck_assert_uint_eq(ring_pop(&a->events, &val), 1);
+    ck_assert_uint_eq(val, 1 << 1 | 1);
+    ck_assert_uint_eq(ring_pop(&a->events, &val), 1);
+    ck_assert_uint_eq(val, 4 << 1 | 0);
+    ck_assert_uint_eq(ring_pop(&a->events, &val), 0);
+
+} END_TEST
+
+Suite* audio_suite(void) {
+
+    TCase* tc_core = tcase_create("core");
+    tcase_add_checked_fixture(tc_core, setup, teardown);
+    tcase_add_test(tc_core, test_audio_ring);
+    tcase_add_test(tc_core, test_audio_render);
+    tcase_add_test(tc_core, test_audio_sound_timer);
+
+    Suite* s = suite_create("audio");
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
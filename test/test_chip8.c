@@ -1,3 +1,6 @@
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
 #include "test_chip8.h"
 
 static chip8* c;
@@ -11,6 +14,7 @@ static void teardown() {
 /* checks the state of a fresh chip8 */
 START_TEST(test_chip8_init) {
 
+    ck_assert_uint_eq( (uintptr_t)c % 64, 0 );
     ck_assert_uint_eq( c->opcode, 0 );
     ck_assert_uint_eq( c->I, 0 );
     ck_assert_uint_eq( c->pc, PROGRAM_START );
@@ -76,6 +80,110 @@ START_TEST(test_chip8_keys) {
 
 } END_TEST
 
+static void log_count(chip8* c, void* user) {
+    (*(int*)user)++;
+}
+
+/* reset restores the initial state but keeps quirks and the log callback */
+START_TEST(test_chip8_reset) {
+    int logged = 0;
+    chip8_quirks_set(c, QUIRK_CLIP);
+    c->log = log_count;
+    c->log_user = &logged;
+    c->flags |= DRAW;
+    chip8_error(c, ERR_STACK_OVERFLOW);
+    c->pc = 0x300;
+    c->V[3] = 7;
+    c->gfx[100] = 1;
+    c->memory[0x400] = 0xAA;
+
+    chip8_reset(c);
+
+    ASSERT_PC(PROGRAM_START);
+    ASSERT_REG(3, 0);
+    ck_assert_uint_eq(c->gfx[100], 0);
+    ck_assert_uint_eq(c->memory[0x400], 0);
+    ck_assert_uint_eq(c->memory[CHARSET_START], font_charset[0]);
+    ck_assert_uint_eq(c->quirks, QUIRK_CLIP);
+    ck_assert_uint_eq(c->flags, 0);
+    ck_assert_uint_eq(c->err, ERR_NONE);
+    ck_assert(c->log == log_count);
+
+    /* the precomputed hash matches the reset state */
+    uint64_t hash = c->hash;
+    chip8_rehash(c);
+    ck_assert(c->hash == hash);
+} END_TEST
+
+START_TEST(test_chip8_program_load_mem) {
+    uint8_t rom[] = { 0x60, 0x2A, 0x12, 0x02 };
+
+    ck_assert_uint_eq(chip8_program_load_mem(c, rom, sizeof(rom)), 0);
+    ck_assert_uint_eq(c->memory[PROGRAM_START], 0x60);
+    ck_assert_uint_eq(c->memory[PROGRAM_START + 3], 0x02);
+    ck_assert_uint_eq(c->rom_size, sizeof(rom));
+    ck_assert(c->rom_hash == chip8_rom_hash(rom, sizeof(rom)));
+
+    /* loading over another rom only rehashes the bytes written */
+    uint8_t other[] = { 0x00, 0x2A, 0xFF };
+    chip8_program_load_mem(c, other, sizeof(other));
+    uint64_t hash = c->hash;
+    chip8_rehash(c);
+    ck_assert(c->hash == hash);
+
+    static uint8_t big[MEM_SIZE - PROGRAM_START + 1];
+    ck_assert_uint_eq(chip8_program_load_mem(c, big, sizeof(big)), 1);
+} END_TEST
+
+/* a file whose size cannot be taken, like a pipe, is not loaded */
+START_TEST(test_chip8_program_load_pipe) {
+    char file[] = "/tmp/test_chip8_XXXXXX";
+    int fd = mkstemp(file);
+    ck_assert(fd >= 0);
+    ck_assert_int_eq(write(fd, "\x60\x2A", 2), 2);
+    close(fd);
+    ck_assert_uint_eq(chip8_program_load(c, file), 0);
+    ck_assert_uint_eq(c->rom_size, 2);
+    ck_assert_uint_eq(c->memory[PROGRAM_START + 1], 0x2A);
+    unlink(file);
+
+    chip8_reset(c);
+    int fds[2];
+    char path[64];
+    ck_assert_int_eq(pipe(fds), 0);
+    ck_assert_int_eq(write(fds[1], "\x60\x2A", 2), 2);
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", fds[0]);
+
+    ck_assert_uint_eq(chip8_program_load(c, path), 1);
+    ck_assert_uint_eq(c->rom_size, 0);
+
+    close(fds[0]);
+    close(fds[1]);
+} END_TEST
+
+/* errors halt silently and record where, the message is formatted on demand */
+START_TEST(test_chip8_error) {
+    char buf[64];
+    ck_assert_str_eq(chip8_strerror(c, buf, sizeof(buf)), "no error");
+
+    c->pc = 0x234;
+    EXEC(0xF0FF)
+    ck_assert(chip8_check_flag(c, HALT));
+    ck_assert_uint_eq(c->err, ERR_INVALID_OPCODE);
+    ck_assert_uint_eq(c->err_pc, 0x234);
+    ck_assert_uint_eq(c->err_opcode, 0xF0FF);
+    ck_assert_str_eq(chip8_strerror(c, buf, sizeof(buf)), "invalid opcode 0xF0FF at 0x234");
+    ck_assert_str_eq(chip8_error_name(c->err), "invalid_opcode");
+
+    int logged = 0;
+    c->log = log_count;
+    c->log_user = &logged;
+    chip8_reset(c);
+    EXEC(0x00EE)
+    ck_assert_int_eq(logged, 1);
+    ck_assert_str_eq(chip8_strerror(c, buf, sizeof(buf)), "return with empty stack at 0x200");
+} END_TEST
+
 
 
 Suite* chip8_suite(void) {
@@ -86,6 +194,10 @@ Suite* chip8_suite(void) {
     tcase_add_test(tc_core, test_chip8_pc);
     tcase_add_test(tc_core, test_chip8_reg);
     tcase_add_test(tc_core, test_chip8_keys);
+    tcase_add_test(tc_core, test_chip8_reset);
+    tcase_add_test(tc_core, test_chip8_program_load_mem);
+    tcase_add_test(tc_core, test_chip8_program_load_pipe);
+    tcase_add_test(tc_core, test_chip8_error);
 
     Suite* s = suite_create("chip8");
     suite_add_tcase(s, tc_core);
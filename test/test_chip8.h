@@ -15,5 +15,18 @@
 
 Suite* chip8_suite(void);
 Suite* opcode_suite(void);
+Suite* memory_suite(void);
+Suite* debugger_suite(void);
+Suite* audio_suite(void);
+Suite* framebuf_suite(void);
+Suite* asm_suite(void);
+Suite* analyze_suite(void);
+Suite* reference_suite(void);
+Suite* state_suite(void);
+Suite* explore_suite(void);
+Suite* metrics_suite(void);
+Suite* corpus_suite(void);
+Suite* input_suite(void);
+Suite* rollout_suite(void);
 
 #endif
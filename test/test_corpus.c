@@ -0,0 +1,164 @@
+#include <string.h>
+#include <unistd.h>
+#include "test_chip8.h"
+#include "../src/corpus.h"
+#include "../src/analyze.h"
+
+static char path[] = "/tmp/chip8_corpus_XXXXXX";
+static void setup() {
+    strcpy(path, "/tmp/chip8_corpus_XXXXXX");
+    close(mkstemp(path));
+    unlink(path);
+}
+static void teardown() {
+    unlink(path);
+}
+
+static const uint8_t rom_a[] = { 0x60, 0x01, 0x12, 0x02 };      /* LD V0 1; JMP 0x202 */
+static const uint8_t rom_b[] = { 0x00, 0xE0, 0x12, 0x00 };      /* CLS; JMP 0x200 */
+static const uint8_t rom_s[] = { 0x00, 0xFF, 0x12, 0x00 };      /* schip HIGH */
+static const uint8_t rom_x[] = { 0x60, 0x01, 0xF1, 0x01 };      /* xo-chip PLANE 1 */
+
+START_TEST(test_corpus_ingest) {
+    corpus_writer* w = corpus_writer_open(path);
+    ck_assert(w != NULL);
+    ck_assert_int_eq(corpus_writer_add(w, rom_a, sizeof(rom_a), 0), 1);
+    ck_assert_int_eq(corpus_writer_add(w, rom_b, sizeof(rom_b), QUIRK_CLIP), 1);
+    ck_assert_int_eq(corpus_writer_add(w, rom_a, sizeof(rom_a), 0), 0);
+    static uint8_t big[MEM_SIZE - PROGRAM_START + 1];
+    ck_assert_int_eq(corpus_writer_add(w, big, sizeof(big), 0), -1);
+    ck_assert_uint_eq(corpus_writer_close(w), 0);
+
+    corpus* cp = corpus_open(path, 0);
+    ck_assert(cp != NULL);
+    ck_assert_uint_eq(corpus_count(cp), 2);
+    ck_assert(cp->entries[0].hash < cp->entries[1].hash);
+
+    corpus_entry* e = corpus_find(cp, chip8_rom_hash(rom_b, sizeof(rom_b)));
+    ck_assert(e != NULL);
+    ck_assert_uint_eq(e->size, sizeof(rom_b));
+    ck_assert_uint_eq(e->quirks, QUIRK_CLIP);
+    ck_assert_uint_eq(e->variant, VARIANT_CHIP8);
+    ck_assert_uint_eq(e->result.key, 0);
+    ck_assert(memcmp(corpus_rom(cp, e), rom_b, sizeof(rom_b)) == 0);
+    ck_assert(corpus_find(cp, 1234) == NULL);
+    corpus_close(cp);
+
+} END_TEST
+
+/* with a cache directory the analysis of each new rom is kept there */
+START_TEST(test_corpus_cache) {
+    char dir[] = "/tmp/chip8_corpus_cache_XXXXXX";
+    ck_assert(mkdtemp(dir) != NULL);
+
+    corpus_writer* w = corpus_writer_open(path);
+    w->cache_dir = dir;
+    ck_assert_int_eq(corpus_writer_add(w, rom_s, sizeof(rom_s), 0), 1);
+    ck_assert_uint_eq(corpus_writer_close(w), 0);
+
+    uint64_t hash = chip8_rom_hash(rom_s, sizeof(rom_s));
+    analysis* a = analysis_load(dir, hash, 0);
+    ck_assert(a != NULL);
+    ck_assert_uint_eq(a->rom_size, sizeof(rom_s));
+    analysis_free(a);
+
+    /* a second archive reuses it */
+    unlink(path);
+    w = corpus_writer_open(path);
+    w->cache_dir = dir;
+    ck_assert_int_eq(corpus_writer_add(w, rom_s, sizeof(rom_s), 0), 1);
+    ck_assert_uint_eq(corpus_writer_close(w), 0);
+    corpus* cp = corpus_open(path, 0);
+    ck_assert_uint_eq(corpus_find(cp, hash)->variant, VARIANT_SCHIP);
+    corpus_close(cp);
+
+    char file[512];
+    snprintf(file, sizeof(file), "%s/%016lx-00.cfg", dir, (unsigned long)hash);
+    unlink(file);
+    rmdir(dir);
+} END_TEST
+
+/* a second ingest appends and keeps the earlier roms and their results */
+START_TEST(test_corpus_append) {
+    corpus_writer* w = corpus_writer_open(path);
+    corpus_writer_add(w, rom_a, sizeof(rom_a), 0);
+    corpus_writer_close(w);
+
+    corpus* cp = corpus_open(path, 1);
+    cp->entries[0].result.key = 42;
+    cp->entries[0].result.cycles = 1000;
+    corpus_close(cp);
+
+    w = corpus_writer_open(path);
+    ck_assert_int_eq(corpus_writer_add(w, rom_a, sizeof(rom_a), 0), 0);
+    ck_assert_int_eq(corpus_writer_add(w, rom_s, sizeof(rom_s), 0), 1);
+    ck_assert_int_eq(corpus_writer_add(w, rom_x, sizeof(rom_x), 0), 1);
+    ck_assert_uint_eq(corpus_writer_close(w), 0);
+
+    cp = corpus_open(path, 0);
+    ck_assert_uint_eq(corpus_count(cp), 3);
+    corpus_entry* e = corpus_find(cp, chip8_rom_hash(rom_a, sizeof(rom_a)));
+    ck_assert_uint_eq(e->result.key, 42);
+    ck_assert_uint_eq(e->result.cycles, 1000);
+    ck_assert(memcmp(corpus_rom(cp, e), rom_a, sizeof(rom_a)) == 0);
+    ck_assert_uint_eq(corpus_find(cp, chip8_rom_hash(rom_s, sizeof(rom_s)))->variant, VARIANT_SCHIP);
+    ck_assert_uint_eq(corpus_find(cp, chip8_rom_hash(rom_x, sizeof(rom_x)))->variant, VARIANT_XOCHIP);
+    corpus_close(cp);
+
+} END_TEST
+
+/* an index pointing outside the file is rejected */
+START_TEST(test_corpus_invalid) {
+    corpus_writer* w = corpus_writer_open(path);
+    corpus_writer_add(w, rom_a, sizeof(rom_a), 0);
+    corpus_writer_close(w);
+
+    corpus* cp = corpus_open(path, 1);
+    cp->entries[0].offset = 1ULL << 40;
+    corpus_close(cp);
+    ck_assert(corpus_open(path, 0) == NULL);
+
+    FILE* f = fopen(path, "wb");
+    fputs("not an archive", f);
+    fclose(f);
+    ck_assert(corpus_open(path, 0) == NULL);
+    ck_assert(corpus_writer_open(path) == NULL);
+
+} END_TEST
+
+/* a rom that cannot be written fails the ingest and keeps the old index */
+START_TEST(test_corpus_write_error) {
+    corpus_writer* w = corpus_writer_open(path);
+    corpus_writer_add(w, rom_a, sizeof(rom_a), 0);
+    ck_assert_uint_eq(corpus_writer_close(w), 0);
+
+    w = corpus_writer_open(path);
+    FILE* full = fopen("/dev/full", "wb");
+    ck_assert(full != NULL);
+    setvbuf(full, NULL, _IONBF, 0);
+    fclose(w->f);
+    w->f = full;
+    ck_assert_int_eq(corpus_writer_add(w, rom_s, sizeof(rom_s), 0), CORPUS_FAILED);
+    ck_assert_int_eq(corpus_writer_add(w, rom_x, sizeof(rom_x), 0), CORPUS_FAILED);
+    ck_assert_uint_eq(corpus_writer_close(w), 1);
+
+    corpus* cp = corpus_open(path, 0);
+    ck_assert(cp != NULL);
+    ck_assert_uint_eq(corpus_count(cp), 1);
+    corpus_close(cp);
+} END_TEST
+
+Suite* corpus_suite(void) {
+    TCase* tc_core = tcase_create("core");
+    tcase_add_checked_fixture(tc_core, setup, teardown);
+    tcase_add_test(tc_core, test_corpus_ingest);
+    tcase_add_test(tc_core, test_corpus_cache);
+    tcase_add_test(tc_core, test_corpus_append);
+    tcase_add_test(tc_core, test_corpus_invalid);
+    tcase_add_test(tc_core, test_corpus_write_error);
+
+    Suite* s = suite_create("corpus");
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
@@ -0,0 +1,150 @@
+#include <string.h>
+#include "test_chip8.h"
+#include "../src/debugger.h"
+#include "../src/disasm.h"
+#include "../src/memory.h"
+
+static chip8* c;
+static debugger* d;
+static void setup() {
+    c = chip8_init();
+    d = debugger_init(stdin, stdout);
+}
+static void teardown() {
+    debugger_free(d);
+    chip8_free(c);
+}
+
+#define ASSERT_DISASM(op, str) \
+    chip8_disasm((op), buf, sizeof(buf)); ck_assert_str_eq(buf, (str));
+
+START_TEST(test_debugger_disasm) {
+    char buf[32];
+
+    ASSERT_DISASM(0x00E0, "CLS")
+    ASSERT_DISASM(0x1abc, "JMP 0xABC")
+    ASSERT_DISASM(0x30ff, "SEQ V0 0xFF")
+    ASSERT_DISASM(0x8121, "AND V1 V2")
+    ASSERT_DISASM(0x812e, "SHL V1 V2")
+    ASSERT_DISASM(0xa123, "LD I 0x123")
+    ASSERT_DISASM(0xd125, "DRAW V1 V2 0x5")
+    ASSERT_DISASM(0xf355, "LD [I] V3")
+    ASSERT_DISASM(0xf365, "LD V3 [I]")
+    ASSERT_DISASM(0x812f, "DW 0x812F")
+    ck_assert_uint_eq(chip8_disasm(0xe0ff, buf, sizeof(buf)), 0);
+
+} END_TEST
+
+START_TEST(test_debugger_condition) {
+    condition cond;
+
+    ck_assert(debugger_condition_compile(&cond, "VF==1"));
+    c->V[0xf] = 0; ck_assert_uint_eq(cond.pred(c, &cond), 0);
+    c->V[0xf] = 1; ck_assert_uint_eq(cond.pred(c, &cond), 1);
+
+    ck_assert(debugger_condition_compile(&cond, "I >= 0x300"));
+    c->I = 0x2ff; ck_assert_uint_eq(cond.pred(c, &cond), 0);
+    c->I = 0x300; ck_assert_uint_eq(cond.pred(c, &cond), 1);
+
+    ck_assert(debugger_condition_compile(&cond, "DT!=0"));
+    ck_assert(!debugger_condition_compile(&cond, "VG==1"));
+    ck_assert(!debugger_condition_compile(&cond, "V0=1"));
+    ck_assert(!debugger_condition_compile(&cond, "V0==x"));
+
+} END_TEST
+
+START_TEST(test_debugger_breakpoints) {
+
+    ck_assert_uint_eq(debugger_check(d, c), 0);
+
+    debugger_break_set(d, PROGRAM_START, NULL);
+    ck_assert_uint_eq(debugger_check(d, c), 1);
+    chip8_pc_incr(c);
+    ck_assert_uint_eq(debugger_check(d, c), 0);
+
+    debugger_break_set(d, PROGRAM_START + 2, "V0==5");
+    ck_assert_uint_eq(debugger_check(d, c), 0);
+    c->V[0] = 5;
+    ck_assert_uint_eq(debugger_check(d, c), 1);
+
+    /* setting it again without a condition makes it unconditional */
+    c->V[0] = 0;
+    debugger_break_set(d, PROGRAM_START + 2, NULL);
+    ck_assert_uint_eq(d->num_conditions, 0);
+    ck_assert_uint_eq(debugger_check(d, c), 1);
+
+    debugger_break_clear(d, PROGRAM_START + 2);
+    ck_assert_uint_eq(debugger_check(d, c), 0);
+    ck_assert_uint_eq(d->num_conditions, 0);
+
+} END_TEST
+
+START_TEST(test_debugger_prompt) {
+    char script[] = "step 2\nregs\nnext\n";
+    char output[1024] = {0};
+
+    /* LD V0 0x12; CALL 0x208; ... */
+    chip8_mem_write16(c, 0x200, 0x6012);
+    chip8_mem_write16(c, 0x202, 0x7001);
+    chip8_mem_write16(c, 0x204, 0x2208);
+
+    d->in = fmemopen(script, strlen(script), "r");
+    d->out = fmemopen(output, sizeof(output) - 1, "w");
+
+    ck_assert_uint_eq(debugger_prompt(d, c), 0);
+    fclose(d->in);
+    fclose(d->out);
+
+    ASSERT_REG(0, 0x13)
+    ASSERT_PC(0x204)
+    ck_assert(strstr(output, "V0 0x13") != NULL);
+    ck_assert(strstr(output, "0x204: CALL 0x208") != NULL);
+
+    /* next over the CALL stops at the instruction after it */
+    ck_assert_uint_eq(debugger_check(d, c), 0);
+    chip8_pc_set(c, 0x206);
+    ck_assert_uint_eq(debugger_check(d, c), 1);
+    ck_assert_uint_eq(debugger_check(d, c), 0);
+
+} END_TEST
+
+static void count_hits(chip8* c, uint16_t addr, uint8_t access, void* user) {
+    (*(uint32_t*)user)++;
+}
+
+/* showing code does not trigger read watchpoints on it */
+START_TEST(test_debugger_watch_display) {
+    char script[] = "disas 200 4\nnext\n";
+    char output[1024] = {0};
+    uint32_t hits = 0;
+
+    chip8_mem_write16(c, 0x200, 0x6012);
+    chip8_watch_add(c, 0x200, 0x208, WATCH_READ);
+    chip8_watch_callback_set(c, count_hits, &hits);
+
+    d->in = fmemopen(script, strlen(script), "r");
+    d->out = fmemopen(output, sizeof(output) - 1, "w");
+    debugger_prompt(d, c);
+    fclose(d->in);
+    fclose(d->out);
+
+    ck_assert(strstr(output, "0x200: LD V0 0x12") != NULL);
+    ck_assert_uint_eq(hits, 0);
+
+} END_TEST
+
+Suite* debugger_suite(void) {
+
+    TCase* tc_core = tcase_create("core");
+    tcase_add_checked_fixture(tc_core, setup, teardown);
+    tcase_add_test(tc_core, test_debugger_disasm);
+    tcase_add_test(tc_core, test_debugger_condition);
+    tcase_add_test(tc_core, test_debugger_breakpoints);
+    tcase_add_test(tc_core, test_debugger_prompt);
+    tcase_add_test(tc_core, test_debugger_watch_display);
+
+    Suite* s = suite_create("debugger");
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
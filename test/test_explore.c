@@ -0,0 +1,162 @@
+#include <string.h>
+#include "test_chip8.h"
+#include "../src/explore.h"
+
+/* waits for a key, only key 5 leads on to a random draw */
+static const uint8_t rom_branches[] = {
+    0xF0, 0x0A,     /* 0x200 LD V0 K */
+    0x30, 0x05,     /* 0x202 SEQ V0 5 */
+    0x12, 0x04,     /* 0x204 JMP 0x204 */
+    0xC1, 0x03,     /* 0x206 RND V1 0x03 */
+    0x31, 0x02,     /* 0x208 SEQ V1 2 */
+    0x12, 0x0A,     /* 0x20A JMP 0x20A */
+    0x12, 0x0C,     /* 0x20C JMP 0x20C */
+};
+
+/* the pc after the key down fork is only passed through */
+static const uint8_t rom_pass[] = {
+    0x60, 0x00,     /* 0x200 LD V0 0 */
+    0xE0, 0x9E,     /* 0x202 SKP V0 */
+    0x12, 0x04,     /* 0x204 JMP 0x204 */
+    0x61, 0x01,     /* 0x206 LD V1 1 */
+    0x12, 0x08,     /* 0x208 JMP 0x208 */
+};
+
+/* counts up V0 until key V1 is pressed */
+static const uint8_t rom_counter[] = {
+    0x70, 0x01,     /* 0x200 ADD V0 1 */
+    0xE1, 0x9E,     /* 0x202 SKP V1 */
+    0x12, 0x00,     /* 0x204 JMP 0x200 */
+    0x12, 0x06,     /* 0x206 JMP 0x206 */
+};
+
+static explore_config cfg;
+
+static void setup() {
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.workers = 1;
+}
+static void teardown() {
+}
+
+static uint8_t goal_pc(chip8* c, void* user) {
+    return c->pc == *(uint16_t*)user;
+}
+
+static uint8_t goal_v0(chip8* c, void* user) {
+    return c->V[0] == *(uint8_t*)user && c->pc == 0x202;
+}
+
+/* every outcome of Fx0A and Cxkk is explored */
+START_TEST(test_explore_all) {
+    explore* e = explore_init(&cfg, rom_branches, sizeof(rom_branches));
+    explore_run(e);
+
+    explore_stats stats;
+    explore_stats_get(e, &stats);
+    ck_assert_uint_eq(stats.states, 1 + NUM_KEYS + 4);
+    ck_assert_uint_eq(stats.loops, NUM_KEYS - 1 + 4);
+    ck_assert_uint_eq(stats.max_depth, 2);
+    ck_assert(explore_goal(e) == NULL);
+
+    explore_free(e);
+} END_TEST
+
+START_TEST(test_explore_goal) {
+    uint16_t goal = 0x20C;
+    cfg.goal = goal_pc;
+    cfg.user = &goal;
+    cfg.workers = 4;
+
+    explore* e = explore_init(&cfg, rom_branches, sizeof(rom_branches));
+    explore_run(e);
+
+    explore_node* path[3];
+    ck_assert(explore_goal(e) != NULL);
+    ck_assert_uint_eq(explore_path(explore_goal(e), path, 3), 3);
+    ck_assert_uint_eq(path[1]->kind, EXPLORE_KEY_WAIT);
+    ck_assert_uint_eq(path[1]->value, 5);
+    ck_assert_uint_eq(path[2]->kind, EXPLORE_RANDOM);
+    ck_assert_uint_eq(path[2]->value, 2);
+
+    explore_free(e);
+} END_TEST
+
+/* a goal in the middle of a segment ends it with a node on the goal */
+START_TEST(test_explore_goal_pass) {
+    uint16_t goal = 0x206;
+    cfg.goal = goal_pc;
+    cfg.user = &goal;
+
+    explore* e = explore_init(&cfg, rom_pass, sizeof(rom_pass));
+    explore_run(e);
+
+    explore_node* path[2];
+    ck_assert(explore_goal(e) != NULL);
+    ck_assert_uint_eq(explore_path(explore_goal(e), path, 2), 2);
+    ck_assert_uint_eq(path[1]->kind, EXPLORE_KEY_DOWN);
+    ck_assert_uint_eq(path[1]->end, EXPLORE_GOAL);
+
+    chip8* c = chip8_init();
+    explore_restore(e, explore_goal(e), c);
+    ASSERT_PC(0x206)
+    chip8_free(c);
+
+    explore_free(e);
+} END_TEST
+
+/* states deeper than a few checkpoints are rebuilt from their deltas */
+START_TEST(test_explore_deltas) {
+    uint8_t v0 = 100;
+    cfg.goal = goal_v0;
+    cfg.user = &v0;
+
+    explore* e = explore_init(&cfg, rom_counter, sizeof(rom_counter));
+    explore_run(e);
+
+    explore_node* goal = explore_goal(e);
+    ck_assert(goal != NULL);
+    ck_assert_uint_eq(goal->depth, 99);
+    ck_assert_uint_eq(goal->kind, EXPLORE_KEY_UP);
+
+    chip8* c = chip8_init();
+    explore_restore(e, goal, c);
+    ASSERT_PC(0x202)
+    ASSERT_REG(0, 100)
+    uint64_t hash = c->hash;
+    chip8_rehash(c);
+    ck_assert(hash == c->hash);
+    chip8_free(c);
+
+    explore_free(e);
+} END_TEST
+
+/* the counter wraps around, so the search ends on duplicates */
+START_TEST(test_explore_dedup) {
+    cfg.workers = 2;
+    explore* e = explore_init(&cfg, rom_counter, sizeof(rom_counter));
+    explore_run(e);
+
+    explore_stats stats;
+    explore_stats_get(e, &stats);
+    ck_assert_uint_eq(stats.duplicates, 1);
+    ck_assert(stats.states > 256);
+    ck_assert(stats.states < 1024);
+
+    explore_free(e);
+} END_TEST
+
+Suite* explore_suite(void) {
+    TCase* tc_core = tcase_create("core");
+    tcase_add_checked_fixture(tc_core, setup, teardown);
+    tcase_add_test(tc_core, test_explore_all);
+    tcase_add_test(tc_core, test_explore_goal);
+    tcase_add_test(tc_core, test_explore_goal_pass);
+    tcase_add_test(tc_core, test_explore_deltas);
+    tcase_add_test(tc_core, test_explore_dedup);
+
+    Suite* s = suite_create("explore");
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
@@ -0,0 +1,69 @@
+#include <string.h>
+#include "test_chip8.h"
+#include "../src/framebuf.h"
+
+static framebuf* f;
+static void setup() {
+    f = framebuf_init();
+}
+static void teardown() {
+    framebuf_free(f);
+}
+
+START_TEST(test_framebuf_latest) {
+    uint8_t gfx[WIDTH * HEIGHT];
+
+    ck_assert(framebuf_acquire(f) == NULL);
+
+    memset(gfx, 1, sizeof(gfx));
+    framebuf_publish(f, gfx);
+    memset(gfx, 2, sizeof(gfx));
+    framebuf_publish(f, gfx);
+
+    /* only the newest frame is presented */
+    uint8_t* frame = framebuf_acquire(f);
+    ck_assert(frame != NULL);
+    ck_assert_uint_eq(frame[0], 2);
+    ck_assert_uint_eq(frame[WIDTH * HEIGHT - 1], 2);
+    ck_assert(framebuf_acquire(f) == NULL);
+
+    /* publishing never touches the frame being presented */
+    memset(gfx, 3, sizeof(gfx));
+    framebuf_publish(f, gfx);
+    framebuf_publish(f, gfx);
+    ck_assert_uint_eq(frame[0], 2);
+    ck_assert_uint_eq(framebuf_acquire(f)[0], 3);
+
+} END_TEST
+
+/* the stamp travels with its frame, also past frames that were dropped */
+START_TEST(test_framebuf_stamp) {
+    uint8_t gfx[WIDTH * HEIGHT] = {0};
+
+    framebuf_publish_stamped(f, gfx, 10);
+    ck_assert(framebuf_acquire(f) != NULL);
+    ck_assert(framebuf_stamp(f) == 10);
+
+    framebuf_publish_stamped(f, gfx, 20);
+    framebuf_publish_stamped(f, gfx, 30);
+    ck_assert(framebuf_acquire(f) != NULL);
+    ck_assert(framebuf_stamp(f) == 30);
+
+    framebuf_publish(f, gfx);
+    ck_assert(framebuf_acquire(f) != NULL);
+    ck_assert(framebuf_stamp(f) == 0);
+
+} END_TEST
+
+Suite* framebuf_suite(void) {
+
+    TCase* tc_core = tcase_create("core");
+    tcase_add_checked_fixture(tc_core, setup, teardown);
+    tcase_add_test(tc_core, test_framebuf_latest);
+    tcase_add_test(tc_core, test_framebuf_stamp);
+
+    Suite* s = suite_create("framebuf");
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
@@ -0,0 +1,113 @@
+#include <string.h>
+#include "test_chip8.h"
+#include "../src/input.h"
+
+static chip8* c;
+static input_queue* q;
+static void setup() {
+    c = chip8_init();
+    q = malloc(sizeof(input_queue));
+    input_queue_init(q, 1000);
+}
+static void teardown() {
+    free(q);
+    chip8_free(c);
+}
+
+START_TEST(test_input_map) {
+    int8_t lut[256];
+    const uint8_t scancodes[] = { 0x0a, 0x34 };
+    const uint8_t keys[] = { 0x1, 0xa };
+    input_map_init(lut, scancodes, keys, 2);
+    ck_assert_int_eq(lut[0x0a], 0x1);
+    ck_assert_int_eq(lut[0x34], 0xa);
+    ck_assert_int_eq(lut[0x00], INPUT_NO_KEY);
+    ck_assert_int_eq(lut[0xff], INPUT_NO_KEY);
+
+    uint64_t e = input_event(123456789, 0xb, 1);
+    ck_assert(input_event_time(e) == 123456789);
+    ck_assert_uint_eq(input_event_key(e), 0xb);
+    ck_assert_uint_eq(input_event_down(e), 1);
+} END_TEST
+
+/* a key reaches the machine at the cycle matching the time it was polled */
+START_TEST(test_input_apply_at_cycle) {
+    input_clock_set(q, 1000000, 100);
+    ck_assert(input_cycle(q, 1000000) == 100);
+    ck_assert(input_cycle(q, 1005000) == 105);
+    ck_assert(input_cycle(q, 999000) == 100);
+
+    ck_assert(input_next_cycle(q) == UINT64_MAX);
+    ring_push(&q->events, input_event(1005000, 0x3, 1));
+    ring_push(&q->events, input_event(1005400, 0x4, 1));
+    ring_push(&q->events, input_event(1007000, 0x3, 0));
+    ck_assert(input_next_cycle(q) == 105);
+
+    /* the emulation loop, long after the events were queued */
+    c->cycles = 100;
+    uint64_t next = input_next_cycle(q);
+    uint8_t down_at = 0, up_at = 0;
+    while (c->cycles < 110) {
+        if (c->cycles >= next) {
+            input_apply(q, c, c->cycles);
+            next = input_next_cycle(q);
+        }
+        if (chip8_key_get(c, 0x3) && !down_at)
+            down_at = c->cycles;
+        if (down_at && !chip8_key_get(c, 0x3) && !up_at)
+            up_at = c->cycles;
+        c->cycles++;
+    }
+    ck_assert_uint_eq(down_at, 105);
+    ck_assert_uint_eq(up_at, 107);
+    ck_assert_uint_eq(chip8_key_get(c, 0x4), 1);
+    ck_assert(q->applied_us == 1007000);
+} END_TEST
+
+START_TEST(test_input_latency) {
+    input_latency* l = malloc(sizeof(input_latency));
+    input_latency_init(l);
+
+    input_latency_sent(l, 1000);
+    input_latency_sent(l, 2000);
+    input_latency_sent(l, 9000);
+
+    /* a frame with nothing new applied measures nothing */
+    input_latency_presented(l, c->counters, 0, 5000);
+    ck_assert_uint_eq(l->count, 0);
+
+    /* the first frame rendered after both keys shows both */
+    input_latency_presented(l, c->counters, 2000, 6000);
+    ck_assert_uint_eq(l->count, 2);
+    ck_assert_uint_eq(l->sum_us, 5000 + 4000);
+    ck_assert_uint_eq(l->max_us, 5000);
+    ck_assert_uint_eq(c->counters->inputs, 2);
+    ck_assert_uint_eq(c->counters->input_latency_us, 9000);
+
+    input_latency_presented(l, NULL, 9000, 30000);
+    ck_assert_uint_eq(l->count, 3);
+    ck_assert_uint_eq(input_latency_percentile(l, 50), 5500);
+    ck_assert_uint_eq(input_latency_percentile(l, 99), 21000);
+
+    /* only the newest INPUT_PENDING inputs are waited for */
+    for (uint32_t i=0; i<INPUT_PENDING + 10; i++)
+        input_latency_sent(l, 40000 + i);
+    ck_assert_uint_eq(l->dropped, 10);
+    input_latency_presented(l, NULL, 50000, 50000);
+    ck_assert_uint_eq(l->count, 3 + INPUT_PENDING);
+
+    free(l);
+} END_TEST
+
+Suite* input_suite(void) {
+    TCase* tc_core = tcase_create("core");
+    tcase_add_checked_fixture(tc_core, setup, teardown);
+    tcase_add_test(tc_core, test_input_map);
+    tcase_add_test(tc_core, test_input_apply_at_cycle);
+    tcase_add_test(tc_core, test_input_latency);
+
+    Suite* s = suite_create("input");
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
@@ -5,6 +5,19 @@ int main(void) {
 
     SRunner* sr = srunner_create(chip8_suite());
     srunner_add_suite(sr, opcode_suite());
+    srunner_add_suite(sr, memory_suite());
+    srunner_add_suite(sr, debugger_suite());
+    srunner_add_suite(sr, audio_suite());
+    srunner_add_suite(sr, framebuf_suite());
+    srunner_add_suite(sr, asm_suite());
+    srunner_add_suite(sr, analyze_suite());
+    srunner_add_suite(sr, reference_suite());
+    srunner_add_suite(sr, state_suite());
+    srunner_add_suite(sr, explore_suite());
+    srunner_add_suite(sr, metrics_suite());
+    srunner_add_suite(sr, corpus_suite());
+    srunner_add_suite(sr, input_suite());
+    srunner_add_suite(sr, rollout_suite());
 
     srunner_run_all(sr, CK_NORMAL);
 
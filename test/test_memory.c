@@ -0,0 +1,90 @@
+#include "test_chip8.h"
+#include "../src/memory.h"
+
+static chip8* c;
+static void setup() {
+    c = chip8_init();
+}
+static void teardown() {
+    chip8_free(c);
+}
+
+static uint16_t hits;
+static uint16_t last_addr;
+static uint8_t  last_access;
+static void watch_cb(chip8* c, uint16_t addr, uint8_t access, void* user) {
+    hits++;
+    last_addr = addr;
+    last_access = access;
+}
+
+/* accesses past the end of memory wrap around */
+START_TEST(test_memory_wrap) {
+
+    chip8_mem_write8(c, MEM_SIZE + 1, 0xab);
+    ck_assert_uint_eq(c->memory[1], 0xab);
+    ck_assert_uint_eq(chip8_mem_read8(c, 0xffff), c->memory[MEM_MASK]);
+
+    c->memory[MEM_MASK] = 0x12; c->memory[0] = 0x34;
+    ck_assert_uint_eq(chip8_mem_read16(c, MEM_MASK), 0x1234);
+
+    chip8_pc_set(c, MEM_MASK);
+    chip8_opcode_fetch(c);
+    ck_assert_uint_eq(c->opcode, 0x1234);
+
+} END_TEST
+
+/* instructions touching memory near the top stay in bounds */
+START_TEST(test_memory_ops_wrap) {
+
+    c->V[0] = 0xde; c->V[1] = 0xad;
+    c->I = MEM_MASK;
+    EXEC(0xf155)
+    ck_assert_uint_eq(c->memory[MEM_MASK], 0xde);
+    ck_assert_uint_eq(c->memory[0], 0xad);
+
+    c->memory[0] = 0xff;
+    c->V[2] = 0; c->V[3] = 0;
+    EXEC(0xD231)
+    ck_assert_uint_eq(c->gfx[0], 1);
+
+} END_TEST
+
+START_TEST(test_memory_watch) {
+
+    hits = 0;
+    ck_assert_uint_eq(chip8_watch_callback_set(c, watch_cb, NULL), 0);
+    ck_assert_uint_eq(chip8_watch_add(c, 0x300, 0x303, WATCH_WRITE), 0);
+    ck_assert_uint_eq(c->watch_pages, 1 << 3);
+
+    chip8_mem_read8(c, 0x300);
+    chip8_mem_write8(c, 0x2ff, 0);
+    chip8_mem_write8(c, 0x304, 0);
+    ck_assert_uint_eq(hits, 0);
+
+    c->I = 0x302; c->V[0] = 0xab;
+    EXEC(0xf055)
+    ck_assert_uint_eq(hits, 1);
+    ck_assert_uint_eq(last_addr, 0x302);
+    ck_assert_uint_eq(last_access, WATCH_WRITE);
+
+    chip8_watch_remove(c, 0x300, 0x303, WATCH_WRITE);
+    ck_assert_uint_eq(c->watch_pages, 0);
+    EXEC(0xf055)
+    ck_assert_uint_eq(hits, 1);
+
+} END_TEST
+
+Suite* memory_suite(void) {
+
+    TCase* tc_core = tcase_create("core");
+    tcase_add_checked_fixture(tc_core, setup, teardown);
+    tcase_add_test(tc_core, test_memory_wrap);
+    tcase_add_test(tc_core, test_memory_ops_wrap);
+    tcase_add_test(tc_core, test_memory_watch);
+
+    Suite* s = suite_create("memory");
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
@@ -0,0 +1,162 @@
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "test_chip8.h"
+#include "../src/metrics.h"
+
+static chip8* c;
+static metrics* m;
+static void setup() {
+    c = chip8_init();
+    m = metrics_init();
+    metrics_register(m, "test \"rom\"", c);
+}
+static void teardown() {
+    metrics_free(m);
+    chip8_free(c);
+}
+
+static const uint8_t program[] = {
+    0x00, 0xE0, /* CLS */
+    0x60, 0x05, /* LD V0 0x05 */
+    0xF0, 0x15, /* LD DT V0 */
+    0xD0, 0x05, /* DRAW V0 V0 5 */
+    0x80, 0x0F, /* invalid */
+};
+
+START_TEST(test_metrics_counters) {
+    ck_assert_uint_eq(((uintptr_t)c->counters) % 64, 0);
+
+    chip8_program_load_mem(c, program, sizeof(program));
+    for (uint8_t i=0; i<8 && !chip8_check_flag(c, HALT); i++)
+        chip8_emulate_cycle(c);
+
+    chip8_counters* k = c->counters;
+    ck_assert_uint_eq(k->instructions, 5);
+    ck_assert_uint_eq(k->clears, 1);
+    ck_assert_uint_eq(k->draws, 1);
+    ck_assert_uint_eq(k->timer_ticks, 3);
+    ck_assert_uint_eq(k->halts, 1);
+    ck_assert_uint_eq(k->errors[ERR_INVALID_OPCODE], 1);
+
+    /* counters survive a reset */
+    chip8_reset(c);
+    ck_assert_uint_eq(k->instructions, 5);
+
+} END_TEST
+
+START_TEST(test_metrics_total) {
+    chip8* other = chip8_init();
+    metrics_register(m, "other", other);
+
+    for (uint8_t i=0; i<3; i++)
+        chip8_emulate_cycle(c);
+    for (uint8_t i=0; i<4; i++)
+        chip8_emulate_cycle(other);
+    counter_add(&other->counters->frames, 2);
+
+    chip8_counters total;
+    metrics_total(m, &total);
+    ck_assert_uint_eq(total.instructions, 7);
+    ck_assert_uint_eq(total.frames, 2);
+
+    metrics_unregister(m, other);
+    chip8_free(other);
+    metrics_total(m, &total);
+    ck_assert_uint_eq(total.instructions, 3);
+
+} END_TEST
+
+START_TEST(test_metrics_write) {
+    chip8_program_load_mem(c, program, sizeof(program));
+    for (uint8_t i=0; i<8 && !chip8_check_flag(c, HALT); i++)
+        chip8_emulate_cycle(c);
+    metrics_sample(m);
+
+    char buf[2048];
+    FILE* f = fmemopen(buf, sizeof(buf), "w");
+    metrics_write(m, f, METRICS_JSON);
+    fclose(f);
+    ck_assert(strstr(buf, "{\"instances\":[{\"instance\":\"test \\\"rom\\\"\"") == buf);
+    ck_assert(strstr(buf, "\"instructions\":5,\"draws\":1,\"clears\":1") != NULL);
+    ck_assert(strstr(buf, "\"errors\":{\"invalid_opcode\":1,\"stack_overflow\":0,\"stack_underflow\":0}") != NULL);
+
+    f = fmemopen(buf, sizeof(buf), "w");
+    metrics_write(m, f, METRICS_TEXT);
+    fclose(f);
+    ck_assert(strstr(buf, "chip8_instructions_total{instance=\"test \\\"rom\\\"\"} 5\n") != NULL);
+    ck_assert(strstr(buf, "chip8_errors_total{instance=\"test \\\"rom\\\"\",reason=\"invalid_opcode\"} 1\n") != NULL);
+
+} END_TEST
+
+START_TEST(test_metrics_dump_file) {
+    char path[] = "/tmp/chip8_metrics_XXXXXX";
+    close(mkstemp(path));
+    unlink(path);
+
+    chip8_emulate_cycle(c);
+    ck_assert_uint_eq(metrics_dump_start(m, path, 5, METRICS_JSON), 0);
+    ck_assert_uint_eq(metrics_dump_start(m, path, 5, METRICS_JSON), 1);
+
+    FILE* f = NULL;
+    for (uint16_t i=0; i<400 && f == NULL; i++) {
+        usleep(5000);
+        f = fopen(path, "r");
+    }
+    ck_assert(f != NULL);
+    char buf[512] = {0};
+    ck_assert(fread(buf, 1, sizeof(buf) - 1, f) > 0);
+    fclose(f);
+    ck_assert(strstr(buf, "\"instructions\":1,") != NULL);
+
+    metrics_dump_stop(m);
+    unlink(path);
+
+} END_TEST
+
+START_TEST(test_metrics_dump_socket) {
+    char path[] = "/tmp/chip8_metrics_XXXXXX";
+    close(mkstemp(path));
+    char target[64];
+    snprintf(target, sizeof(target), "unix:%s", path);
+
+    chip8_emulate_cycle(c);
+    chip8_emulate_cycle(c);
+    ck_assert_uint_eq(metrics_dump_start(m, target, 5, METRICS_TEXT), 0);
+    usleep(20000);
+
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    strcpy(addr.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    ck_assert_int_eq(connect(fd, (struct sockaddr*)&addr, sizeof(addr)), 0);
+
+    char buf[1024] = {0};
+    size_t len = 0;
+    ssize_t n;
+    while ((n = read(fd, buf + len, sizeof(buf) - 1 - len)) > 0)
+        len += n;
+    close(fd);
+    ck_assert(strstr(buf, "chip8_instructions_total{instance=\"test \\\"rom\\\"\"} 2\n") != NULL);
+    ck_assert(strstr(buf, "chip8_mips{") != NULL);
+
+    /* the socket is removed when the dump stops */
+    metrics_dump_stop(m);
+    ck_assert_int_ne(access(path, F_OK), 0);
+
+} END_TEST
+
+Suite* metrics_suite(void) {
+    TCase* tc_core = tcase_create("core");
+    tcase_add_checked_fixture(tc_core, setup, teardown);
+    tcase_add_test(tc_core, test_metrics_counters);
+    tcase_add_test(tc_core, test_metrics_total);
+    tcase_add_test(tc_core, test_metrics_write);
+    tcase_add_test(tc_core, test_metrics_dump_file);
+    tcase_add_test(tc_core, test_metrics_dump_socket);
+
+    Suite* s = suite_create("metrics");
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
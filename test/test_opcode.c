@@ -1,5 +1,6 @@
 #include <check.h>
 #include "test_chip8.h"
+#include "../src/quirks.h"
 
 static chip8* c;
 static void setup() {
@@ -19,11 +20,50 @@ START_TEST(test_flow_subroutine) {
     ck_assert_uint_eq(c->stack[0], pc);
 
     EXEC(0x00ee) /* ret */
-    ASSERT_PC(pc)
+    ASSERT_PC(pc+2)
     ck_assert_uint_eq(c->sp, 0);
 
 } END_TEST
 
+START_TEST(test_flow_wait_key) {
+
+    uint16_t pc = chip8_pc_get(c);
+    EXEC(0xf30a) /* LD V3 K */
+    ASSERT_PC(pc)
+
+    chip8_key_set(c, 0x9, 1);
+    chip8_key_set(c, 0xb, 1);
+    EXEC(0xf30a)
+    ASSERT_PC(pc+2)
+    ASSERT_REG(3, 0x9)
+
+} END_TEST
+
+/* 0nnn is decoded in full, only 00E0 and 00EE have a low byte meaning */
+START_TEST(test_flow_sys) {
+
+    uint16_t pc = chip8_pc_get(c);
+    c->gfx[0] = 1;
+    EXEC(0x01e0) /* SYS 0x1E0 */
+    ck_assert_uint_eq(c->gfx[0], 1);
+    ck_assert(chip8_check_flag(c, HALT));
+    ASSERT_PC(pc)
+
+} END_TEST
+
+/* an invalid opcode halts with pc still on it */
+START_TEST(test_flow_invalid) {
+
+    uint16_t pc = chip8_pc_get(c);
+    EXEC(0x8008)
+    ck_assert(chip8_check_flag(c, HALT));
+    ASSERT_PC(pc)
+
+    EXEC(0xf0ff)
+    ASSERT_PC(pc)
+
+} END_TEST
+
 START_TEST(test_flow_skip) {
     uint16_t pc;
 
@@ -90,15 +130,16 @@ START_TEST(test_flow_jump) {
 
 START_TEST(test_math_add) {
 
-    c->V[0] = 0x12;
+    /* 7xkk leaves VF alone, it has no carry flag in the spec */
+    c->V[0] = 0x12; c->V[0xf] = 0x5a;
     EXEC(0x7034); /* ADD V0 0x34 */
     ASSERT_REG(0, 0x12 + 0x34)
-    ASSERT_REG(0xf, 0)
+    ASSERT_REG(0xf, 0x5a)
 
     c->V[0] = 0x12;
     EXEC(0x70ff); /* ADD V0 0xff */
     ASSERT_REG(0, 0x12 + 0xff)
-    ASSERT_REG(0xf, 1)
+    ASSERT_REG(0xf, 0x5a)
 
     c->V[0] = 0x12; c->V[1] = 0x34;
     EXEC(0x8014); /* ADD V0 V1 */
@@ -110,6 +151,17 @@ START_TEST(test_math_add) {
     ASSERT_REG(0, 0x12 + 0xff)
     ASSERT_REG(0xf, 1)
 
+    /* operands are read before VF is written */
+    c->V[0] = 0x12; c->V[0xf] = 0xff;
+    EXEC(0x80f4); /* ADD V0 VF */
+    ASSERT_REG(0, 0x11)
+    ASSERT_REG(0xf, 1)
+
+    /* VF is written last */
+    c->V[0] = 0xff; c->V[0xf] = 0x12;
+    EXEC(0x8f04); /* ADD VF V0 */
+    ASSERT_REG(0xf, 1)
+
     c->I = 0x123; c->V[0] = 0x45;
     EXEC(0xf01e) /* ADD I V0 */
     ck_assert_uint_eq(c->I, 0x123 + 0x45);
@@ -117,27 +169,38 @@ START_TEST(test_math_add) {
 } END_TEST
 
 
+/* VF is NOT borrow for SUB and SUBN, as in the spec */
 START_TEST(test_math_sub) {
 
     c->V[0] = 0x43; c->V[1] = 0x21;
     EXEC(0x8015); /* SUB V0 V1 */
     ASSERT_REG(0, 0x43 - 0x21)
-    ASSERT_REG(0xf, 0)
+    ASSERT_REG(0xf, 1)
 
     c->V[0] = 0x12; c->V[1] = 0x34;
     EXEC(0x8015); /* SUB V0 V1 */
     ASSERT_REG(0, 0x12 - 0x34)
+    ASSERT_REG(0xf, 0)
+
+    c->V[0] = 0x12; c->V[1] = 0x12;
+    EXEC(0x8015); /* SUB V0 V1 */
+    ASSERT_REG(0, 0)
     ASSERT_REG(0xf, 1)
 
     c->V[0] = 0x34; c->V[1] = 0x12;
     EXEC(0x8017); /* SUBN V0 V1 */
-    ASSERT_REG(0, 0x12-0x34)
-    ASSERT_REG(0xf, 1)
+    ASSERT_REG(0, 0x12 - 0x34)
+    ASSERT_REG(0xf, 0)
 
     c->V[0] = 0x21; c->V[1] = 0x43;
     EXEC(0x8017); /* SUBN V0 V1 */
-    ASSERT_REG(0, 0x43-0x21)
-    ASSERT_REG(0xf, 0)
+    ASSERT_REG(0, 0x43 - 0x21)
+    ASSERT_REG(0xf, 1)
+
+    c->V[0] = 0x21; c->V[1] = 0x21;
+    EXEC(0x8017); /* SUBN V0 V1 */
+    ASSERT_REG(0, 0)
+    ASSERT_REG(0xf, 1)
 
 } END_TEST
 
@@ -157,6 +220,29 @@ START_TEST(test_math_logic) {
 
 } END_TEST
 
+START_TEST(test_load_random) {
+
+    /* kk masks the random byte, all 256 values can come up */
+    uint8_t seen[256] = {0};
+    for (uint16_t i=0; i<4096; i++) {
+        EXEC(0xc0ff) /* RND V0 0xff */
+        seen[chip8_reg_get(c,0)] = 1;
+        EXEC(0xc10f) /* RND V1 0x0f */
+        ck_assert_uint_eq(chip8_reg_get(c,1) & 0xf0, 0);
+    }
+    for (uint16_t i=0; i<256; i++)
+        ck_assert_uint_eq(seen[i], 1);
+
+    /* the sequence restarts on reset, so runs replay */
+    chip8_reset(c);
+    EXEC(0xc0ff)
+    uint8_t first = chip8_reg_get(c,0);
+    chip8_reset(c);
+    EXEC(0xc0ff)
+    ASSERT_REG(0, first)
+
+} END_TEST
+
 START_TEST(test_load_registers) {
 
     EXEC(0x60ab) /* V0 = 0xab */
@@ -193,6 +279,16 @@ START_TEST(test_load_bcd) {
     ck_assert_uint_eq(c->memory[c->I+2], (0xab % 10));
 } END_TEST
 
+/* only the low nibble of Vx selects the digit */
+START_TEST(test_load_font) {
+    c->V[0] = 0x0a;
+    EXEC(0xf029)
+    ck_assert_uint_eq(c->I, CHARSET_START + 0xa * BYTES_PER_CHAR);
+    c->V[0] = 0x1a;
+    EXEC(0xf029)
+    ck_assert_uint_eq(c->I, CHARSET_START + 0xa * BYTES_PER_CHAR);
+} END_TEST
+
 START_TEST(test_load_memory) {
     c->V[0] = 0xde; c->V[1] = 0xad;
     c->V[2] = 0xbe; c->V[3] = 0xef;
@@ -212,10 +308,96 @@ START_TEST(test_load_memory) {
     ASSERT_REG(3, 0xef)
 } END_TEST
 
+START_TEST(test_quirks_shift) {
+
+    c->V[0] = 0x01; c->V[1] = 0x82;
+    EXEC(0x8016) /* SHR V0 V1 */
+    ASSERT_REG(0, 0x00)
+    ASSERT_REG(0xf, 1)
+
+    chip8_quirks_set(c, QUIRK_SHIFT_VY);
+    c->V[0] = 0x01; c->V[1] = 0x82;
+    EXEC(0x8016) /* SHR V0 V1 */
+    ASSERT_REG(0, 0x41)
+    ASSERT_REG(0xf, 0)
+
+    c->V[0] = 0x01; c->V[1] = 0x82;
+    EXEC(0x801e) /* SHL V0 V1 */
+    ASSERT_REG(0, 0x04)
+    ASSERT_REG(0xf, 1)
+
+} END_TEST
+
+START_TEST(test_quirks_vf_reset) {
+
+    c->V[0] = 0x12; c->V[1] = 0x34; c->V[0xf] = 0xab;
+    EXEC(0x8011) /* AND V0 V1 */
+    ASSERT_REG(0xf, 0xab)
+
+    chip8_quirks_set(c, QUIRK_VF_RESET);
+    EXEC(0x8012) /* OR V0 V1 */
+    ASSERT_REG(0xf, 0)
+
+} END_TEST
+
+START_TEST(test_quirks_load_store) {
+
+    c->I = 0x300;
+    EXEC(0xf355)
+    ck_assert_uint_eq(c->I, 0x300);
+
+    chip8_quirks_set(c, QUIRK_LOAD_STORE_I);
+    EXEC(0xf355)
+    ck_assert_uint_eq(c->I, 0x304);
+    EXEC(0xf165)
+    ck_assert_uint_eq(c->I, 0x306);
+
+} END_TEST
+
+START_TEST(test_quirks_jump) {
+
+    chip8_quirks_set(c, QUIRK_JUMP_VX);
+    c->V[0] = 0x01; c->V[2] = 0x10;
+    EXEC(0xB234) /* JMP V2 0x234 */
+    ASSERT_PC(0x234 + 0x10)
+
+} END_TEST
+
+START_TEST(test_quirks_draw) {
+
+    /* 0xF0 from the charset, drawn across the right edge */
+    c->I = CHARSET_START;
+    c->V[0] = WIDTH - 2; c->V[1] = HEIGHT - 1;
+    EXEC(0xD011)
+    ck_assert_uint_eq(c->gfx[(HEIGHT-1)*WIDTH + WIDTH-1], 1);
+    ck_assert_uint_eq(c->gfx[(HEIGHT-1)*WIDTH + 0], 1);
+    ck_assert_uint_eq(c->gfx[(HEIGHT-1)*WIDTH + 1], 1);
+    ASSERT_REG(0xf, 0)
+
+    chip8_quirks_set(c, QUIRK_CLIP);
+    c->V[0] = WIDTH - 2 + WIDTH; /* start position still wraps */
+    EXEC(0xD011)
+    ck_assert_uint_eq(c->gfx[(HEIGHT-1)*WIDTH + WIDTH-1], 0);
+    ck_assert_uint_eq(c->gfx[(HEIGHT-1)*WIDTH + 0], 1);
+    ASSERT_REG(0xf, 1)
+
+} END_TEST
+
+START_TEST(test_quirks_names) {
+
+    ck_assert_uint_eq(quirks_from_name("shift_vy"), QUIRK_SHIFT_VY);
+    ck_assert_uint_eq(quirks_from_name("clip"), QUIRK_CLIP);
+    ck_assert_uint_eq(quirks_from_name("bogus"), 0);
+
+} END_TEST
+
 Suite* opcode_suite(void) {
     TCase* tc_flow = tcase_create("program flow");
     tcase_add_checked_fixture(tc_flow, setup, teardown);
     tcase_add_test(tc_flow, test_flow_subroutine);
+    tcase_add_test(tc_flow, test_flow_wait_key);
+    tcase_add_test(tc_flow, test_flow_sys);
+    tcase_add_test(tc_flow, test_flow_invalid);
     tcase_add_test(tc_flow, test_flow_skip);
     tcase_add_test(tc_flow, test_flow_skip_keys);
     tcase_add_test(tc_flow, test_flow_jump);
@@ -229,14 +411,26 @@ Suite* opcode_suite(void) {
     TCase* tc_load = tcase_create("load");
     tcase_add_checked_fixture(tc_load, setup, teardown);
     tcase_add_test(tc_load, test_load_registers);
+    tcase_add_test(tc_load, test_load_random);
     tcase_add_test(tc_load, test_load_timers);
     tcase_add_test(tc_load, test_load_bcd);
+    tcase_add_test(tc_load, test_load_font);
     tcase_add_test(tc_load, test_load_memory);
 
+    TCase* tc_quirks = tcase_create("quirks");
+    tcase_add_checked_fixture(tc_quirks, setup, teardown);
+    tcase_add_test(tc_quirks, test_quirks_shift);
+    tcase_add_test(tc_quirks, test_quirks_vf_reset);
+    tcase_add_test(tc_quirks, test_quirks_load_store);
+    tcase_add_test(tc_quirks, test_quirks_jump);
+    tcase_add_test(tc_quirks, test_quirks_draw);
+    tcase_add_test(tc_quirks, test_quirks_names);
+
     Suite* s = suite_create("opcode");
     suite_add_tcase(s, tc_flow);
     suite_add_tcase(s, tc_math);
     suite_add_tcase(s, tc_load);
+    suite_add_tcase(s, tc_quirks);
 
     return s;
 }
@@ -0,0 +1,117 @@
+#include <string.h>
+#include "test_chip8.h"
+#include "../src/reference.h"
+
+#define RANDOM_ROMS   256
+#define RANDOM_CYCLES 400
+
+static chip8* c;
+static ref r;
+
+static void setup() {
+    c = chip8_init();
+}
+static void teardown() {
+    chip8_free(c);
+}
+
+static void load(const uint8_t* rom, size_t size, uint8_t quirks) {
+    chip8_reset(c);
+    chip8_quirks_set(c, quirks);
+    ref_reset(&r, quirks);
+    chip8_program_load_mem(c, rom, size);
+    ref_load(&r, rom, size);
+}
+
+static void assert_same_state() {
+    ck_assert_uint_eq(c->pc, r.pc);
+    ck_assert_uint_eq(c->I, r.I);
+    ck_assert_uint_eq(c->sp, r.sp);
+    ck_assert_uint_eq(c->delay_timer, r.dt);
+    ck_assert_uint_eq(c->sound_timer, r.st);
+    ck_assert_uint_eq(chip8_check_flag(c, HALT) != 0, r.halted);
+    ck_assert(memcmp(c->V, r.V, sizeof(c->V)) == 0);
+    ck_assert(memcmp(c->memory, r.mem, sizeof(c->memory)) == 0);
+    ck_assert(memcmp(c->gfx, r.gfx, sizeof(c->gfx)) == 0);
+    ck_assert(chip8_state_hash(c) == ref_state_hash(&r));
+}
+
+/* both engines agree on a short program using every register flag case */
+START_TEST(test_reference_program) {
+    uint8_t rom[] = {
+        0x6F, 0xF0,     /* LD VF 0xF0 */
+        0x60, 0x20,     /* LD V0 0x20 */
+        0x80, 0xF4,     /* ADD V0 VF */
+        0x8F, 0x05,     /* SUB VF V0 */
+        0x22, 0x0C,     /* CALL 0x20C */
+        0x12, 0x0A,     /* JMP 0x20A */
+        0xA0, 0x50,     /* LD I 0x050 */
+        0xD0, 0x15,     /* DRAW V0 V1 5 */
+        0xF0, 0x33,     /* LD B V0 */
+        0x00, 0xEE,     /* RET */
+    };
+    load(rom, sizeof(rom), 0);
+    for (uint8_t i=0; i<20; i++) {
+        chip8_emulate_cycle(c);
+        ref_step(&r);
+        assert_same_state();
+    }
+    ASSERT_PC(0x20A)
+} END_TEST
+
+/*
+ * random instruction streams under random quirks,
+ * compared after every cycle
+ * */
+START_TEST(test_reference_random) {
+    uint32_t x = 0x12345678;
+    uint8_t rom[64];
+
+    for (uint16_t n=0; n<RANDOM_ROMS; n++) {
+        for (uint8_t i=0; i<sizeof(rom); i++) {
+            x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+            rom[i] = x;
+        }
+        load(rom, sizeof(rom), n & 0x1F);
+
+        for (uint16_t i=0; i<RANDOM_CYCLES && !r.halted; i++) {
+            uint8_t key = (i / 16) & 0x1F;
+            for (uint8_t k=0; k<NUM_KEYS; k++) {
+                chip8_key_set(c, k, k == key);
+                r.keys[k] = k == key;
+            }
+            chip8_emulate_cycle(c);
+            ref_step(&r);
+            assert_same_state();
+        }
+    }
+} END_TEST
+
+/* the incremental hash matches a hash computed from scratch */
+START_TEST(test_reference_rehash) {
+    uint8_t rom[] = {
+        0x60, 0x12, 0x61, 0x34, 0xA3, 0x00, 0xF1, 0x55,  /* store V0-V1 at 0x300 */
+        0x62, 0xFF, 0x72, 0x02, 0xF2, 0x33,               /* V2 wraps, BCD */
+    };
+    load(rom, sizeof(rom), 0);
+    for (uint8_t i=0; i<7; i++)
+        chip8_emulate_cycle(c);
+
+    uint64_t hash = c->hash;
+    chip8_rehash(c);
+    ck_assert(hash == c->hash);
+    ck_assert(hash != 0);
+} END_TEST
+
+Suite* reference_suite(void) {
+    TCase* tc_core = tcase_create("core");
+    tcase_add_checked_fixture(tc_core, setup, teardown);
+    tcase_add_test(tc_core, test_reference_program);
+    tcase_add_test(tc_core, test_reference_random);
+    tcase_add_test(tc_core, test_reference_rehash);
+
+    Suite* s = suite_create("reference");
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
@@ -0,0 +1,135 @@
+#include <string.h>
+#include "test_chip8.h"
+#include "../src/rollout.h"
+#include "../src/metrics.h"
+
+/* counts up V0 on every pass while key 5 is down */
+static const uint8_t rom_held[] = {
+    0x61, 0x05,     /* 0x200 LD V1 5 */
+    0xE1, 0xA1,     /* 0x202 SKNP V1 */
+    0x70, 0x01,     /* 0x204 ADD V0 1 */
+    0x12, 0x02,     /* 0x206 JMP 0x202 */
+};
+
+static chip8* c;
+static void setup() {
+    c = chip8_init();
+    chip8_program_load_mem(c, rom_held, sizeof(rom_held));
+}
+static void teardown() {
+    chip8_free(c);
+}
+
+static int64_t score_v0(chip8* c, void* user) {
+    __atomic_fetch_add((uint32_t*)user, 1, __ATOMIC_RELAXED);
+    return c->V[0];
+}
+
+/* the clone runs on exactly like the original, with its own counters and watchpoints */
+START_TEST(test_chip8_clone) {
+    for (uint8_t i=0; i<10; i++)
+        chip8_emulate_cycle(c);
+    chip8_key_set(c, 5, 1);
+
+    chip8* d = chip8_init();
+    struct chip8_counters_t* counters = d->counters;
+    d->watch_pages = 0x8000;
+    chip8_clone(d, c);
+    ck_assert(d->counters == counters);
+    ck_assert_uint_eq(d->watch_pages, 0x8000);
+    ck_assert(d->hash == c->hash);
+    ck_assert(d->cycles == c->cycles);
+    ck_assert_uint_eq(d->pc, c->pc);
+
+    for (uint8_t i=0; i<30; i++) {
+        chip8_emulate_cycle(c);
+        chip8_emulate_cycle(d);
+    }
+    ck_assert(d->hash == c->hash);
+    ASSERT_REG(0, d->V[0]);
+    ck_assert(d->V[0] > 0);
+    ck_assert_uint_eq(d->counters->instructions, 30);
+
+    chip8_free(d);
+} END_TEST
+
+/* keys change at frame boundaries and the run starts from the origin */
+START_TEST(test_rollout_play) {
+    uint16_t keys[4] = { 0, 1 << 5, 1 << 5, 0 };
+    rollout_job job = { .keys = keys, .frames = 4 };
+    chip8* d = chip8_init();
+
+    chip8_clone(d, c);
+    rollout_play(d, &job, 16);
+    ck_assert(job.cycles == 64);
+    ck_assert_uint_eq(job.halted, 0);
+    uint8_t v0 = d->V[0];
+    ck_assert(v0 > 0);
+
+    /* the same keys one frame later count the same */
+    uint16_t later[5] = { 0, 0, 1 << 5, 1 << 5, 0 };
+    rollout_job shifted = { .keys = later, .frames = 5 };
+    chip8_clone(d, c);
+    rollout_play(d, &shifted, 16);
+    ck_assert_uint_eq(d->V[0], v0);
+
+    uint16_t none[4] = { 0 };
+    rollout_job idle = { .keys = none, .frames = 4 };
+    chip8_clone(d, c);
+    rollout_play(d, &idle, 16);
+    ck_assert_uint_eq(d->V[0], 0);
+    ck_assert_uint_eq(c->V[0], 0);
+
+    chip8_free(d);
+} END_TEST
+
+/* a batch spread over the pool scores every job as a single thread would */
+START_TEST(test_rollout_run) {
+    uint32_t calls = 0;
+    rollout_config cfg = { .workers = 4, .score = score_v0, .user = &calls };
+    rollout_pool* p = rollout_pool_init(&cfg);
+    ck_assert_ptr_ne(p, NULL);
+    ck_assert_uint_eq(p->started, 4);
+
+    enum { JOBS = 200, FRAMES = 8 };
+    static uint16_t keys[JOBS][FRAMES];
+    static rollout_job jobs[JOBS];
+    for (uint32_t i=0; i<JOBS; i++) {
+        for (uint32_t f=0; f<FRAMES; f++)
+            keys[i][f] = (i >> f) & 1 ? 1 << 5 : 1 << 3;
+        jobs[i] = (rollout_job) { .keys = keys[i], .frames = FRAMES };
+    }
+
+    for (uint8_t round=0; round<3; round++) {
+        calls = 0;
+        rollout_run(p, c, jobs, JOBS);
+        ck_assert_uint_eq(calls, JOBS);
+
+        chip8* d = chip8_init();
+        for (uint32_t i=0; i<JOBS; i++) {
+            rollout_job job = { .keys = keys[i], .frames = FRAMES };
+            chip8_clone(d, c);
+            rollout_play(d, &job, ROLLOUT_CYCLES_PER_FRAME);
+            ck_assert(jobs[i].score == d->V[0]);
+            ck_assert(jobs[i].cycles == FRAMES * ROLLOUT_CYCLES_PER_FRAME);
+        }
+        chip8_free(d);
+    }
+    ck_assert(jobs[0].score == 0);
+    ck_assert(jobs[JOBS - 1].score > 0);
+
+    rollout_pool_free(p);
+} END_TEST
+
+Suite* rollout_suite(void) {
+    TCase* tc_core = tcase_create("core");
+    tcase_add_checked_fixture(tc_core, setup, teardown);
+    tcase_add_test(tc_core, test_chip8_clone);
+    tcase_add_test(tc_core, test_rollout_play);
+    tcase_add_test(tc_core, test_rollout_run);
+
+    Suite* s = suite_create("rollout");
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}
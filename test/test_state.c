@@ -0,0 +1,100 @@
+#include <string.h>
+#include "test_chip8.h"
+#include "../src/state.h"
+
+static chip8* c;
+static void setup() {
+    c = chip8_init();
+}
+static void teardown() {
+    chip8_free(c);
+}
+
+/* the O(1) hash follows every kind of write and matches a rehash */
+START_TEST(test_state_hash_incremental) {
+    uint64_t initial = chip8_state_hash(c);
+
+    c->I = CHARSET_START;
+    EXEC(0xD005) /* DRAW V0 V0 5 */
+    EXEC(0x2300) /* CALL 0x300 */
+    EXEC(0x6a12) /* LD VA 0x12 */
+    c->I = 0x400;
+    EXEC(0xFA33) /* LD B VA */
+    ck_assert(chip8_state_hash(c) != initial);
+
+    uint64_t hash = c->hash;
+    chip8_rehash(c);
+    ck_assert(hash == c->hash);
+
+    /* undoing every change gives back the initial hash */
+    EXEC(0x00EE) /* RET */
+    c->I = CHARSET_START;
+    EXEC(0xD005)
+    EXEC(0x00E0) /* CLS */
+    EXEC(0x6a00)
+    EXEC(0x6f00)
+    chip8_mem_write8(c, 0x401, 0);
+    chip8_mem_write8(c, 0x402, 0);
+    c->I = 0;
+    c->pc = PROGRAM_START;
+    ck_assert(chip8_state_hash(c) == initial);
+} END_TEST
+
+/* registers outside c->hash are covered by chip8_state_hash */
+START_TEST(test_state_hash_registers) {
+    uint64_t hash = chip8_state_hash(c);
+    c->delay_timer = 1;
+    ck_assert(chip8_state_hash(c) != hash);
+    c->delay_timer = 0;
+    c->sp = 1;
+    ck_assert(chip8_state_hash(c) != hash);
+    c->sp = 0;
+    ck_assert(chip8_state_hash(c) == hash);
+} END_TEST
+
+START_TEST(test_state_set) {
+    state_set* s = state_set_init(4);
+
+    for (uint64_t i=0; i<1000; i++)
+        ck_assert_int_eq(state_set_insert(s, i * 0x9E3779B97F4A7C15ULL), 1);
+    for (uint64_t i=0; i<1000; i++) {
+        ck_assert_int_eq(state_set_insert(s, i * 0x9E3779B97F4A7C15ULL), 0);
+        ck_assert_uint_eq(state_set_contains(s, i * 0x9E3779B97F4A7C15ULL), 1);
+    }
+    ck_assert_uint_eq(state_set_contains(s, 12345), 0);
+    ck_assert_uint_eq(s->count, 1000);
+
+    state_set_free(s);
+} END_TEST
+
+START_TEST(test_state_loop) {
+    uint8_t rom[] = {
+        0x60, 0x00,     /* LD V0 0 */
+        0x70, 0x01,     /* ADD V0 1 */
+        0x30, 0x05,     /* SEQ V0 5 */
+        0x12, 0x02,     /* JMP 0x202 */
+        0x12, 0x00,     /* JMP 0x200 */
+    };
+    chip8_program_load_mem(c, rom, sizeof(rom));
+    ck_assert_uint_eq(chip8_loop_find(c, 1000), 16);
+
+    /* a program that halts does not loop */
+    uint8_t halt[] = { 0x60, 0x00, 0xFF, 0xFF };
+    chip8_reset(c);
+    chip8_program_load_mem(c, halt, sizeof(halt));
+    ck_assert_uint_eq(chip8_loop_find(c, 1000), 0);
+} END_TEST
+
+Suite* state_suite(void) {
+    TCase* tc_core = tcase_create("core");
+    tcase_add_checked_fixture(tc_core, setup, teardown);
+    tcase_add_test(tc_core, test_state_hash_incremental);
+    tcase_add_test(tc_core, test_state_hash_registers);
+    tcase_add_test(tc_core, test_state_set);
+    tcase_add_test(tc_core, test_state_loop);
+
+    Suite* s = suite_create("state");
+    suite_add_tcase(s, tc_core);
+
+    return s;
+}